@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+#  run_bench.sh
+#  mlqfs
+#
+#  End to end benchmark: builds mlqfs and the workload generator, then
+#  simulates generated workloads over a matrix of process counts and arrival
+#  processes, and prints one CSV line per run with the mlqfs -p summary.
+#
+#  $ ./run_bench.sh [process_counts] [seed] [workload options...]
+#  $ ./run_bench.sh "1000 10000" 7 -c 40 -i 10
+#
+
+set -e
+cd "$(dirname "$0")"
+
+COUNTS=${1:-"1000 3000 10000 30000"}
+SEED=${2:-1}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/mlqfs_bench.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+gcc -O2 -o "$WORK/mlqfs" -I../prioque ../prioque/prioque.c $(ls ../*.c) -lpthread
+gcc -O2 -o "$WORK/workload" workload.c -lm
+
+echo "processes,arrivals,lines,load_ms,simulation_ms,ticks,ticks_per_sec,events,events_per_sec,peak_rss_kb"
+for count in $COUNTS; do
+    for arrivals in poisson bursty; do
+        "$WORK/workload" -n "$count" -s "$SEED" -a "$arrivals" "$@" > "$WORK/trace.txt"
+        summary=$("$WORK/mlqfs" -p "$WORK/trace.txt" /dev/null 2>&1 >/dev/null | grep '^perf:')
+        echo "$count,$arrivals,$(wc -l < "$WORK/trace.txt" | tr -d ' '),$(echo "$summary" | sed 's/^perf: //; s/[a-z_]*=//g; s/ /,/g')"
+    done
+done
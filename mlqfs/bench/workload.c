@@ -0,0 +1,133 @@
+/**
+ *  workload.c
+ *  mlqfs
+ *
+ *  Synthetic workload generator: writes process descriptions in the
+ *  mlqfs input format, reproducibly from a seed.
+ *
+ *  $ gcc -O2 -o workload workload.c -lm
+ *  $ ./workload [-n processes] [-s seed] [-a poisson|bursty] [-m mean_interarrival]
+ *               [-B burst_size] [-c mean_cpu] [-i mean_io] [-d exponential|uniform]
+ *               [-b max_behaviours] [-R max_repeats] > trace.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+typedef struct Workload {
+    int processes;
+    unsigned long long seed;
+    int bursty;                 // arrivals come in bursts instead of a Poisson process.
+    double mean_interarrival;   // ticks between arrivals, or between bursts divided by the burst size.
+    int burst_size;
+    double mean_cpu;            // ticks of a CPU burst.
+    double mean_io;             // ticks of an I/O wait.
+    int uniform;                // bursts uniform in [0, 2 * mean] instead of exponential.
+    int max_behaviours;         // behaviours chained per process, drawn in [1, max].
+    int max_repeats;            // repeats of a behaviour, drawn in [1, max].
+} Workload;
+
+static unsigned long long random_state;
+
+
+/**
+ * @brief Uniform double in ]0, 1[ (splitmix64).
+ */
+static double next_uniform(void) {
+    unsigned long long z = (random_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return ((z >> 11) + 0.5) / 9007199254740992.0;
+}
+
+
+static double next_exponential(double mean) {
+    return -mean * log(next_uniform());
+}
+
+
+static unsigned int next_between(unsigned int low, unsigned int high) {
+    return low + (unsigned int)(next_uniform() * (high - low + 1));
+}
+
+
+/**
+ * @brief Length of a CPU or I/O burst, at least one tick for CPU bursts.
+ */
+static unsigned int next_burst(Workload *workload, double mean, unsigned int minimum) {
+    double length = workload->uniform ? next_uniform() * 2 * mean : next_exponential(mean);
+    return length < minimum ? minimum : (unsigned int)(length + 0.5);
+}
+
+
+static void generate(Workload *workload) {
+    double arrival = 0;
+
+    for (int pid = 1; pid <= workload->processes; pid ++) {
+        int behaviours = (int)next_between(1, workload->max_behaviours);
+
+        // a Poisson process, or bursts of burst_size processes arriving together.
+        if (!workload->bursty) {
+            arrival += next_exponential(workload->mean_interarrival);
+        } else if ((pid - 1) % workload->burst_size == 0) {
+            arrival += next_exponential(workload->mean_interarrival * workload->burst_size);
+        }
+
+        for (int i = 0; i < behaviours; i ++) {
+            printf("%u %d %u %u %u\n", (unsigned int)arrival, pid,
+                   next_burst(workload, workload->mean_cpu, 1),
+                   next_burst(workload, workload->mean_io, 0),
+                   next_between(1, workload->max_repeats));
+        }
+    }
+}
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n processes] [-s seed] [-a poisson|bursty] [-m mean_interarrival] [-B burst_size]\n", name);
+    fprintf(stderr, "       [-c mean_cpu] [-i mean_io] [-d exponential|uniform] [-b max_behaviours] [-R max_repeats]\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    Workload workload = {
+        .processes = 1000, .seed = 1, .bursty = 0, .mean_interarrival = 200, .burst_size = 50,
+        .mean_cpu = 20, .mean_io = 30, .uniform = 0, .max_behaviours = 3, .max_repeats = 5,
+    };
+    int option;
+
+    while ((option = getopt(argc, argv, "n:s:a:m:B:c:i:d:b:R:")) != -1) {
+        switch (option) {
+            case 'n': workload.processes = atoi(optarg); break;
+            case 's': workload.seed = strtoull(optarg, NULL, 10); break;
+            case 'a':
+                if (strcmp(optarg, "poisson") != 0 && strcmp(optarg, "bursty") != 0) { usage(argv[0]); return 1; }
+                workload.bursty = strcmp(optarg, "bursty") == 0;
+                break;
+            case 'm': workload.mean_interarrival = atof(optarg); break;
+            case 'B': workload.burst_size = atoi(optarg); break;
+            case 'c': workload.mean_cpu = atof(optarg); break;
+            case 'i': workload.mean_io = atof(optarg); break;
+            case 'd':
+                if (strcmp(optarg, "exponential") != 0 && strcmp(optarg, "uniform") != 0) { usage(argv[0]); return 1; }
+                workload.uniform = strcmp(optarg, "uniform") == 0;
+                break;
+            case 'b': workload.max_behaviours = atoi(optarg); break;
+            case 'R': workload.max_repeats = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (workload.processes < 0 || workload.mean_interarrival < 0 || workload.burst_size < 1 || workload.mean_cpu <= 0
+        || workload.mean_io < 0 || workload.max_behaviours < 1 || workload.max_repeats < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    random_state = workload.seed;
+    generate(&workload);
+    return 0;
+}
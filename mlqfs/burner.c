@@ -0,0 +1,129 @@
+/**
+ *  burner.c
+ *  mlqfs
+ *
+ *  Child processes backing the simulated processes in real scheduling mode.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "burner.h"
+
+
+/**
+ * @brief Start a burner, stopped
+ * Forks a child which stops itself, then either spins on the CPU forever,
+ * or runs 'command' with /bin/sh when one is given.
+ * @returns the child pid, or -1 if it could not be started.
+ */
+pid_t spawn_burner(const char *command) {
+    int status;
+    pid_t burner = fork();
+
+    if (burner == 0) {
+        raise(SIGSTOP);
+        if (command != NULL) {
+            execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+            _exit(127);
+        }
+        for (volatile unsigned long spin = 0; ; spin ++) {}
+    }
+
+    // make sure it is stopped before the scheduler accounts for it.
+    if (burner > 0 && waitpid(burner, &status, WUNTRACED) != burner) {
+        kill_burner(burner);
+        return -1;
+    }
+    return burner;
+}
+
+
+static void sleep_ns(long long nanoseconds) {
+    struct timespec delay = { nanoseconds / 1000000000LL, nanoseconds % 1000000000LL };
+    while (nanosleep(&delay, &delay) != 0) {}
+}
+
+
+/**
+ * @brief Let a burner run for one tick
+ * Continues the burner, sleeps 'tick_ns', stops it again and waits until
+ * it is stopped.
+ * @returns the CPU nanoseconds it consumed during the tick, or -1 if it
+ * exited: it is then reaped, and must not be granted, killed or waited on again.
+ */
+long long grant_tick(pid_t burner, long long tick_ns) {
+    int status;
+    pid_t waited;
+    long long before = burner_cpu_time(burner), after;
+
+    kill(burner, SIGCONT);
+    sleep_ns(tick_ns);
+    kill(burner, SIGSTOP);
+    do {
+        waited = waitpid(burner, &status, WUNTRACED);
+    } while (waited < 0 && errno == EINTR);
+    if (waited != burner || !WIFSTOPPED(status)) {
+        return -1;
+    }
+
+    after = burner_cpu_time(burner);
+    // without /proc, assume the burner used the whole tick.
+    return (before < 0 || after < 0) ? tick_ns : after - before;
+}
+
+
+/**
+ * @brief Sleep for one tick, when only the null process runs.
+ */
+void idle_tick(long long tick_ns) {
+    sleep_ns(tick_ns);
+}
+
+
+/**
+ * @brief CPU time consumed by a burner
+ * Read from /proc/[pid]/schedstat (nanoseconds) or /proc/[pid]/stat (clock ticks).
+ * @returns nanoseconds, or -1 where /proc is not available.
+ */
+long long burner_cpu_time(pid_t burner) {
+    char path[64], line[1024], *fields;
+    long long on_cpu;
+    unsigned long user, system;
+    FILE *stream;
+
+    snprintf(path, sizeof(path), "/proc/%d/schedstat", (int)burner);
+    stream = fopen(path, "r");
+    if (stream != NULL) {
+        int parsed = fscanf(stream, "%lld", &on_cpu);
+        fclose(stream);
+        if (parsed == 1) { return on_cpu; }
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)burner);
+    stream = fopen(path, "r");
+    if (stream == NULL) { return -1; }
+    fields = fgets(line, sizeof(line), stream);
+    fclose(stream);
+
+    // utime and stime are the 14th and 15th fields, after the parenthesized command name.
+    if (fields == NULL || (fields = strrchr(line, ')')) == NULL
+        || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &user, &system) != 2) {
+        return -1;
+    }
+    return (long long)(user + system) * (1000000000LL / sysconf(_SC_CLK_TCK));
+}
+
+
+/**
+ * @brief Kill a burner and reap it.
+ */
+void kill_burner(pid_t burner) {
+    int status;
+    kill(burner, SIGKILL);
+    waitpid(burner, &status, 0);
+}
@@ -0,0 +1,48 @@
+/**
+ *  burner.h
+ *  mlqfs
+ *
+ *  Child processes backing the simulated processes in real scheduling mode.
+ *  mlqfs grants them CPU time tick by tick with SIGCONT and SIGSTOP.
+ */
+
+#ifndef burner_h
+#define burner_h
+
+#include <sys/types.h>
+
+/**
+ * @brief Start a burner, stopped
+ * Forks a child which stops itself, then either spins on the CPU forever,
+ * or runs 'command' with /bin/sh when one is given.
+ * @returns the child pid, or -1 if it could not be started.
+ */
+pid_t spawn_burner(const char *command);
+
+/**
+ * @brief Let a burner run for one tick
+ * Continues the burner, sleeps 'tick_ns', stops it again and waits until
+ * it is stopped.
+ * @returns the CPU nanoseconds it consumed during the tick, or -1 if it
+ * exited: it is then reaped, and must not be granted, killed or waited on again.
+ */
+long long grant_tick(pid_t burner, long long tick_ns);
+
+/**
+ * @brief Sleep for one tick, when only the null process runs.
+ */
+void idle_tick(long long tick_ns);
+
+/**
+ * @brief CPU time consumed by a burner
+ * Read from /proc/[pid]/schedstat (nanoseconds) or /proc/[pid]/stat (clock ticks).
+ * @returns nanoseconds, or -1 where /proc is not available.
+ */
+long long burner_cpu_time(pid_t burner);
+
+/**
+ * @brief Kill a burner and reap it.
+ */
+void kill_burner(pid_t burner);
+
+#endif /* burner_h */
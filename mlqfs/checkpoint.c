@@ -0,0 +1,100 @@
+/**
+ *  checkpoint.c
+ *  mlqfs
+ *
+ *  Binary snapshot helpers for the MLQFScheduler state.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+
+
+int write_u32(FILE *stream, unsigned int value) {
+    unsigned char bytes[4];
+    for (int i = 0; i < 4; i ++) { bytes[i] = (value >> (8 * i)) & 0xff; }
+    return fwrite(bytes, sizeof(bytes), 1, stream) == 1;
+}
+
+
+int read_u32(FILE *stream, unsigned int *value) {
+    unsigned char bytes[4];
+    if (fread(bytes, sizeof(bytes), 1, stream) != 1) { return FALSE; }
+    *value = 0;
+    for (int i = 0; i < 4; i ++) { *value |= (unsigned int)bytes[i] << (8 * i); }
+    return TRUE;
+}
+
+
+int write_u64(FILE *stream, unsigned long long value) {
+    return write_u32(stream, value & 0xffffffff) && write_u32(stream, value >> 32);
+}
+
+
+int read_u64(FILE *stream, unsigned long long *value) {
+    unsigned int low, high;
+    if (!read_u32(stream, &low) || !read_u32(stream, &high)) { return FALSE; }
+    *value = ((unsigned long long)high << 32) | low;
+    return TRUE;
+}
+
+
+int write_double(FILE *stream, double value) {
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return write_u64(stream, bits);
+}
+
+
+int read_double(FILE *stream, double *value) {
+    unsigned long long bits;
+    if (!read_u64(stream, &bits)) { return FALSE; }
+    memcpy(value, &bits, sizeof(bits));
+    return TRUE;
+}
+
+
+/**
+ * @brief Serialize a queue
+ * Writes the element count followed by every (priority, element) pair
+ * from front to rear. Uses a local context, the global queue position
+ * is left untouched.
+ */
+int write_queue(FILE *stream, Queue *queue, ElementWriter write_element) {
+    Context context;
+
+    if (!write_u32(stream, queue_length(queue))) { return FALSE; }
+
+    local_init_context(queue, &context);
+    while (!local_end_of_queue(&context)) {
+        if (!write_u32(stream, local_current_priority(&context))) { return FALSE; }
+        if (!write_element(stream, local_pointer_to_current(&context))) { return FALSE; }
+        local_next_element(&context);
+    }
+    return TRUE;
+}
+
+
+/**
+ * @brief Deserialize a queue
+ * Appends the serialized elements to an initialised queue, in order, so the
+ * equal priority ordering of the saved queue is preserved.
+ */
+int read_queue(FILE *stream, Queue *queue, ElementReader read_element) {
+    unsigned int length, priority;
+    int success = TRUE;
+    void *element = malloc(queue->elementsize);
+
+    if (element == NULL || !read_u32(stream, &length)) {
+        free(element);
+        return FALSE;
+    }
+
+    for (unsigned int i = 0; i < length && success; i ++) {
+        success = read_u32(stream, &priority) && read_element(stream, element);
+        if (success) { add_to_queue(queue, element, (int)priority); }
+    }
+
+    free(element);
+    return success;
+}
@@ -0,0 +1,54 @@
+/**
+ *  checkpoint.h
+ *  mlqfs
+ *
+ *  Binary snapshot helpers for the MLQFScheduler state.
+ *  All integers are stored little endian, whatever the host byte order,
+ *  so a checkpoint can be resumed on another machine.
+ */
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <stdio.h>
+#include "prioque.h"
+
+#define CHECKPOINT_MAGIC 0x5346514d   // "MQFS"
+#define CHECKPOINT_VERSION 6
+
+/**
+ * @brief Element serializer used by write_queue.
+ * @returns TRUE on success, FALSE on a write error.
+ */
+typedef int (*ElementWriter)(FILE *stream, void *element);
+
+/**
+ * @brief Element deserializer used by read_queue.
+ * The element buffer is sized with the queue elementsize.
+ * @returns TRUE on success, FALSE on a read error or malformed data.
+ */
+typedef int (*ElementReader)(FILE *stream, void *element);
+
+int write_u32(FILE *stream, unsigned int value);
+int read_u32(FILE *stream, unsigned int *value);
+int write_u64(FILE *stream, unsigned long long value);
+int read_u64(FILE *stream, unsigned long long *value);
+int write_double(FILE *stream, double value);
+int read_double(FILE *stream, double *value);
+
+/**
+ * @brief Serialize a queue
+ * Writes the element count followed by every (priority, element) pair
+ * from front to rear. Uses a local context, the global queue position
+ * is left untouched.
+ */
+int write_queue(FILE *stream, Queue *queue, ElementWriter write_element);
+
+/**
+ * @brief Deserialize a queue
+ * Appends the serialized elements to an initialised queue, in order, so the
+ * equal priority ordering of the saved queue is preserved.
+ */
+int read_queue(FILE *stream, Queue *queue, ElementReader read_element);
+
+#endif /* checkpoint_h */
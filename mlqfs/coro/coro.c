@@ -0,0 +1,194 @@
+/**
+ *  coro.c
+ *  mlqfs
+ *
+ *  Single threaded coroutine executor using the multilevel feedback queues.
+ */
+
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "coro.h"
+
+static const int QUANTUM_THRESHOLD[LEVELS] = DEFAULT_QUANTUM_THRESHOLD;
+
+
+static long long wall_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+
+static long long thread_cpu_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+/**
+ * @brief Initialise an executor
+ * @param tick_ns CPU nanoseconds of one tick: the level quanta are
+ *        DEFAULT_QUANTUM_THRESHOLD ticks long.
+ */
+void init_executor(Executor *executor, ExecutorPolicy policy, long long tick_ns) {
+    init_queue(&executor->ready, sizeof(Coroutine *), TRUE, NULL, FALSE);
+    init_queue(&executor->io, sizeof(Coroutine *), TRUE, NULL, FALSE);
+    executor->policy = policy;
+    executor->origin = wall_time();
+    for (int level = MAX_PRIORITY; level <= MIN_PRIORITY; level ++) {
+        executor->quantum[level] = QUANTUM_THRESHOLD[level] * tick_ns;
+    }
+}
+
+
+/**
+ * @brief Start a coroutine at the highest priority
+ * The coroutine struct is owned by the caller and must outlive its execution.
+ */
+void spawn(Executor *executor, Coroutine *coroutine, CoroutineFunction function, void *data) {
+    coroutine->function = function;
+    coroutine->data = data;
+    coroutine->line = 0;
+    coroutine->level = MAX_PRIORITY;
+    coroutine->promotion = 0;
+    coroutine->demotion = 0;
+    coroutine->quanta = 0;
+    coroutine->io_delay = 0;
+    add_to_queue(&executor->ready, &coroutine, coroutine->level);
+}
+
+
+/**
+ * @brief Move the io queue origin forward before its priorities overflow an int.
+ */
+static void rebase_io_queue(Executor *executor, long long now) {
+    Queue rebased;
+    Coroutine *coroutine;
+    long long shift = now - executor->origin;
+
+    init_queue(&rebased, sizeof(Coroutine *), TRUE, NULL, FALSE);
+    while (queue_length(&executor->io) > 0) {
+        int priority = current_priority(&executor->io);
+        remove_from_front(&executor->io, &coroutine);
+        add_to_queue(&rebased, &coroutine, priority > shift ? (int)(priority - shift) : 0);
+    }
+    destroy_queue(&executor->io);
+    executor->io = rebased;
+    executor->origin = now;
+}
+
+
+/**
+ * @brief Queue the coroutines whose I/O completed back to their level
+ * Like queue_new_processes() for the io queue.
+ * @returns the time left before the next I/O completion in microseconds, -1 if none.
+ */
+static long long complete_io(Executor *executor) {
+    Coroutine *coroutine;
+    long long now = wall_time() - executor->origin;
+
+    while (queue_length(&executor->io) > 0 && current_priority(&executor->io) <= now) {
+        remove_from_front(&executor->io, &coroutine);
+        add_to_queue(&executor->ready, &coroutine, coroutine->level);
+    }
+    return queue_length(&executor->io) > 0 ? current_priority(&executor->io) - now : -1;
+}
+
+
+/**
+ * @brief Check if a coroutine of a higher level than 'level' is ready.
+ */
+static int preempted(Executor *executor, int level) {
+    complete_io(executor);
+    return queue_length(&executor->ready) > 0 && current_priority(&executor->ready) < level;
+}
+
+
+/**
+ * @brief Suspend a coroutine on I/O
+ * Resets its quantum and increments its promotion counter, promoting it at
+ * the level threshold, then queues it until the I/O completes.
+ */
+static void await_io(Executor *executor, Coroutine *coroutine) {
+    long long wake = wall_time() - executor->origin + coroutine->io_delay;
+
+    if (executor->policy == EXECUTOR_MLQFS) {
+        coroutine->promotion ++;
+        coroutine->demotion = 0;
+        coroutine->quanta = 0;
+        if (coroutine->promotion >= PROMOTION_THRESHOLD[coroutine->level]) {
+            coroutine->promotion = 0;
+            if (coroutine->level != MAX_PRIORITY) { coroutine->level --; }
+        }
+    }
+
+    if (wake > INT_MAX / 2) {
+        rebase_io_queue(executor, wall_time());
+        wake = coroutine->io_delay;
+    }
+    add_to_queue(&executor->io, &coroutine, (int)wake);
+}
+
+
+/**
+ * @brief Requeue a yielding coroutine at the rear of its level
+ * A coroutine which exhausted its quantum increments its demotion counter,
+ * and is demoted at the level threshold.
+ */
+static void halt(Executor *executor, Coroutine *coroutine) {
+    if (executor->policy == EXECUTOR_MLQFS && coroutine->quanta >= executor->quantum[coroutine->level]) {
+        coroutine->demotion ++;
+        coroutine->promotion = 0;
+        coroutine->quanta = 0;
+        if (coroutine->demotion >= DEMOTION_THRESHOLD[coroutine->level]) {
+            coroutine->demotion = 0;
+            if (coroutine->level != MIN_PRIORITY) { coroutine->level ++; }
+        }
+    }
+    add_to_queue(&executor->ready, &coroutine, coroutine->level);
+}
+
+
+/**
+ * @brief Run the coroutines until all of them are done
+ * Sleeps while every coroutine awaits I/O.
+ */
+void run_executor(Executor *executor) {
+    Coroutine *coroutine;
+    CoroutineStatus status;
+
+    while (queue_length(&executor->ready) > 0 || queue_length(&executor->io) > 0) {
+        long long next_io = complete_io(executor);
+
+        if (queue_length(&executor->ready) == 0) {
+            usleep((useconds_t)next_io);
+            continue;
+        }
+
+        remove_from_front(&executor->ready, &coroutine);
+        do {
+            long long start = thread_cpu_time();
+            status = coroutine->function(coroutine);
+            coroutine->quanta += thread_cpu_time() - start;
+        } while (status == CO_YIELDED && executor->policy == EXECUTOR_MLQFS
+                 && coroutine->quanta < executor->quantum[coroutine->level]
+                 && !preempted(executor, coroutine->level));
+
+        switch (status) {
+            case CO_DONE: break;
+            case CO_YIELDED: halt(executor, coroutine); break;
+            case CO_AWAITING: await_io(executor, coroutine); break;
+        }
+    }
+}
+
+
+/**
+ * @brief Free the executor queues.
+ */
+void destroy_executor(Executor *executor) {
+    destroy_queue(&executor->ready);
+    destroy_queue(&executor->io);
+}
@@ -0,0 +1,97 @@
+/**
+ *  coro.h
+ *  mlqfs
+ *
+ *  Stackless coroutines and a single threaded executor whose ready
+ *  structure is the multilevel feedback queue hierarchy.
+ *
+ *  A coroutine is a function resumed from its last suspension point:
+ *
+ *      CoroutineStatus handler(Coroutine *self) {
+ *          Request *request = self->data;     // locals don't survive a suspension.
+ *          CO_BEGIN(self);
+ *          while (request->pending) {
+ *              parse(request);
+ *              CO_AWAIT_IO(self, 500);         // like send_process_to_io()
+ *              compute(request);
+ *              CO_YIELD(self);                 // like halt_process() once past the quantum.
+ *          }
+ *          CO_END(self);
+ *      }
+ *
+ *  Coroutines start at MAX_PRIORITY. One that yields after exhausting the
+ *  quantum of its level gets the demotion counter of halt_process(), one
+ *  that awaits I/O gets the promotion counter of send_process_to_io().
+ *  A coroutine yielding within its quantum is resumed right away, unless
+ *  a higher level coroutine is ready.
+ */
+
+#ifndef coro_h
+#define coro_h
+
+#include "prioque.h"
+#include "policy.h"
+
+typedef enum CoroutineStatus {
+    CO_DONE,
+    CO_YIELDED,
+    CO_AWAITING
+} CoroutineStatus;
+
+typedef struct Coroutine Coroutine;
+typedef CoroutineStatus (*CoroutineFunction)(Coroutine *self);
+
+struct Coroutine {
+    CoroutineFunction function;
+    void *data;                 // coroutine state, preserved across suspensions.
+    int line;                   // resume point, 0 before the first run.
+    int level;
+    int promotion;
+    int demotion;
+    long long quanta;           // CPU nanoseconds consumed in the current quantum.
+    long long io_delay;         // microseconds of the awaited I/O.
+};
+
+#define CO_BEGIN(co)            switch ((co)->line) { case 0:
+#define CO_YIELD(co)            do { (co)->line = __LINE__; return CO_YIELDED; case __LINE__:; } while (0)
+#define CO_AWAIT_IO(co, us)     do { (co)->io_delay = (us); (co)->line = __LINE__; return CO_AWAITING; case __LINE__:; } while (0)
+#define CO_END(co)              } (co)->line = -1; return CO_DONE
+
+typedef enum ExecutorPolicy {
+    EXECUTOR_MLQFS,             // multilevel feedback queues.
+    EXECUTOR_FIFO               // single level, resumed in order. Used as a baseline.
+} ExecutorPolicy;
+
+typedef struct Executor {
+    Queue ready;                // Coroutine pointers, by level.
+    Queue io;                   // Coroutine pointers, by I/O completion time.
+    ExecutorPolicy policy;
+    long long quantum[LEVELS];  // level quanta in CPU nanoseconds.
+    long long origin;           // wall clock origin of the io queue priorities, in microseconds.
+} Executor;
+
+/**
+ * @brief Initialise an executor
+ * @param tick_ns CPU nanoseconds of one tick: the level quanta are
+ *        DEFAULT_QUANTUM_THRESHOLD ticks long.
+ */
+void init_executor(Executor *executor, ExecutorPolicy policy, long long tick_ns);
+
+/**
+ * @brief Start a coroutine at the highest priority
+ * The coroutine struct is owned by the caller and must outlive its execution.
+ */
+void spawn(Executor *executor, Coroutine *coroutine, CoroutineFunction function, void *data);
+
+/**
+ * @brief Run the coroutines until all of them are done
+ * Sleeps while every coroutine awaits I/O.
+ */
+void run_executor(Executor *executor);
+
+/**
+ * @brief Free the executor queues.
+ */
+void destroy_executor(Executor *executor);
+
+#endif /* coro_h */
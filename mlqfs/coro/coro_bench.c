@@ -0,0 +1,146 @@
+/**
+ *  coro_bench.c
+ *  mlqfs
+ *
+ *  Tail latency of interactive coroutines sharing the executor with batch
+ *  coroutines, with the multilevel policy and with the FIFO baseline.
+ *
+ *  Interactive coroutines wait for a request (simulated I/O), then serve it
+ *  with a short CPU burst. The latency of a request is the time from its
+ *  arrival to the end of its burst. Batch coroutines compute in slices,
+ *  yielding between two slices.
+ *
+ *  $ gcc -O2 -o coro_bench -I../prioque -I.. ../prioque/prioque.c coro.c coro_bench.c
+ *  $ ./coro_bench [interactive] [batch] [requests]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "coro.h"
+
+#define TICK_NS 100000LL                // quanta of 1, 3 and 10 ms.
+#define THINK_US 2000                   // delay between two requests of a client.
+#define SERVICE_NS 30000LL              // CPU burst of a request.
+#define SLICE_NS 250000LL               // CPU burst of a batch slice.
+#define BATCH_NS 150000000LL            // CPU work of a batch coroutine.
+
+typedef struct Client {
+    int served;
+    int requests;
+    long long arrival;
+    long long *latencies;               // shared, indexed by request number.
+    int *recorded;
+} Client;
+
+typedef struct Batch {
+    long long done;
+} Batch;
+
+
+static long long wall_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+static void burn(long long nanoseconds) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    do {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec) < nanoseconds);
+}
+
+
+static CoroutineStatus client(Coroutine *self) {
+    Client *state = self->data;
+    CO_BEGIN(self);
+    while (state->served < state->requests) {
+        // the request arrives when the I/O completes.
+        state->arrival = wall_time() + THINK_US * 1000LL;
+        CO_AWAIT_IO(self, THINK_US);
+        burn(SERVICE_NS);
+        state->latencies[(*state->recorded) ++] = wall_time() - state->arrival;
+        state->served ++;
+    }
+    CO_END(self);
+}
+
+
+static CoroutineStatus batch(Coroutine *self) {
+    Batch *state = self->data;
+    CO_BEGIN(self);
+    while (state->done < BATCH_NS) {
+        burn(SLICE_NS);
+        state->done += SLICE_NS;
+        CO_YIELD(self);
+    }
+    CO_END(self);
+}
+
+
+static int compare_latency(const void *lhs, const void *rhs) {
+    long long left = *(const long long *)lhs, right = *(const long long *)rhs;
+    return (left > right) - (left < right);
+}
+
+
+static void run(const char *name, ExecutorPolicy policy, int clients, int batches, int requests) {
+    Executor executor;
+    Coroutine *coroutines = calloc(clients + batches, sizeof(Coroutine));
+    Client *client_states = calloc(clients, sizeof(Client));
+    Batch *batch_states = calloc(batches, sizeof(Batch));
+    long long *latencies = calloc((size_t)clients * requests, sizeof(long long));
+    long long start = wall_time(), total = 0;
+    int recorded = 0;
+
+    if (coroutines == NULL || client_states == NULL || batch_states == NULL || latencies == NULL) {
+        fprintf(stderr, "coro_bench: out of memory.\n");
+        exit(1);
+    }
+
+    init_executor(&executor, policy, TICK_NS);
+    for (int i = 0; i < batches; i ++) {
+        spawn(&executor, &coroutines[i], batch, &batch_states[i]);
+    }
+    for (int i = 0; i < clients; i ++) {
+        client_states[i].requests = requests;
+        client_states[i].latencies = latencies;
+        client_states[i].recorded = &recorded;
+        spawn(&executor, &coroutines[batches + i], client, &client_states[i]);
+    }
+    run_executor(&executor);
+    destroy_executor(&executor);
+
+    for (int i = 0; i < recorded; i ++) { total += latencies[i]; }
+    qsort(latencies, recorded, sizeof(long long), compare_latency);
+
+    printf("%-6s latency: mean %8.1f us  p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  max %8.1f us  (total %.2f s)\n",
+           name, total / 1e3 / recorded, latencies[recorded / 2] / 1e3, latencies[(recorded * 99) / 100] / 1e3,
+           latencies[(recorded * 999) / 1000] / 1e3, latencies[recorded - 1] / 1e3, (wall_time() - start) / 1e9);
+
+    free(latencies);
+    free(batch_states);
+    free(client_states);
+    free(coroutines);
+}
+
+
+int main(int argc, const char *argv[]) {
+    int clients = argc >= 2 ? atoi(argv[1]) : 8;
+    int batches = argc >= 3 ? atoi(argv[2]) : 4;
+    int requests = argc >= 4 ? atoi(argv[3]) : 200;
+
+    if (clients < 1 || batches < 0 || requests < 1) {
+        fprintf(stderr, "usage: %s [interactive] [batch] [requests]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d interactive coroutines x %d requests, %d batch coroutines of %lld ms\n",
+           clients, requests, batches, BATCH_NS / 1000000);
+    run("mlqfs", EXECUTOR_MLQFS, clients, batches, requests);
+    run("fifo", EXECUTOR_FIFO, clients, batches, requests);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ *  feed.c
+ *  mlqfs
+ *
+ *  Non-blocking reader for live process descriptions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "prioque.h"
+#include "feed.h"
+
+
+static void init_feed(Feed *feed, int fd) {
+    feed->fd = fd;
+    feed->eof = FALSE;
+    feed->length = 0;
+    feed->tokens = 0;
+    feed->offset = 0;
+    feed->consumed = 0;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+
+/**
+ * @brief Open a file or FIFO feed
+ * Blocks until a producer opens the FIFO for writing, then switches the
+ * stream to non-blocking mode.
+ * @returns TRUE on success.
+ */
+int open_file_feed(Feed *feed, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { return FALSE; }
+    init_feed(feed, fd);
+    return TRUE;
+}
+
+
+/**
+ * @brief Open a Unix socket feed
+ * Binds a stream socket at 'path' and blocks until one producer connects.
+ * The feed ends when that producer disconnects.
+ * @returns TRUE on success.
+ */
+int open_socket_feed(Feed *feed, const char *path) {
+    struct sockaddr_un address;
+    struct stat status;
+    int listener, fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return FALSE;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    // replace the socket left behind by a previous run.
+    if (stat(path, &status) == 0 && S_ISSOCK(status.st_mode)) { unlink(path); }
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) { return FALSE; }
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listener, 1) < 0) {
+        close(listener);
+        return FALSE;
+    }
+
+    do {
+        fd = accept(listener, NULL, NULL);
+    } while (fd < 0 && errno == EINTR);
+
+    close(listener);
+    unlink(path);
+    if (fd < 0) { return FALSE; }
+
+    init_feed(feed, fd);
+    return TRUE;
+}
+
+
+/**
+ * @brief Move the feed to a stream offset, used when resuming from a checkpoint.
+ * @returns TRUE if the stream is seekable.
+ */
+int seek_feed(Feed *feed, unsigned long long offset) {
+    if (lseek(feed->fd, (off_t)offset, SEEK_SET) < 0) { return FALSE; }
+    feed->length = 0;
+    feed->tokens = 0;
+    feed->offset = offset;
+    feed->consumed = offset;
+    return TRUE;
+}
+
+
+/**
+ * @brief Read whatever the producer has written
+ * Waits at most 'timeout' milliseconds for data (negative waits forever,
+ * 0 only polls). Once the feed has ended, simply sleeps for the timeout.
+ */
+void poll_feed(Feed *feed, int timeout) {
+    struct pollfd descriptor;
+
+    if (feed->eof) {
+        if (timeout > 0) { poll(NULL, 0, timeout); }
+        return;
+    }
+
+    descriptor.fd = feed->fd;
+    descriptor.events = POLLIN;
+    if (poll(&descriptor, 1, timeout) <= 0) { return; }
+
+    while (feed->length < FEED_BUFFER_SIZE) {
+        ssize_t count = read(feed->fd, feed->buffer + feed->length, FEED_BUFFER_SIZE - feed->length);
+        if (count > 0) {
+            feed->length += (int)count;
+            continue;
+        }
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { break; }
+
+        // end of stream, or a broken producer.
+        if (count < 0) { perror("mlqfs: feed"); }
+        close_feed(feed);
+        break;
+    }
+}
+
+
+/**
+ * @brief Extract the next complete record from the buffered data
+ * A record is FEED_RECORD_SIZE whitespace separated integers, newlines are
+ * not significant, like the fscanf based batch loader.
+ *
+ * @param record receives the record values.
+ * @param start receives the stream offset from which the record can be read again.
+ * @returns TRUE if a record was extracted.
+ */
+int next_feed_record(Feed *feed, long record[FEED_RECORD_SIZE], unsigned long long *start) {
+    int position = 0, found = FALSE;
+
+    while (!found) {
+        char token[32], *end_of_number;
+        int begin = position, end;
+        long value;
+
+        while (begin < feed->length && isspace((unsigned char)feed->buffer[begin])) { begin ++; }
+        end = begin;
+        while (end < feed->length && !isspace((unsigned char)feed->buffer[end])) { end ++; }
+
+        // nothing left, or a token the producer may still be writing.
+        if (begin == feed->length || (end == feed->length && !feed->eof)) {
+            position = begin;
+            break;
+        }
+        position = end;
+
+        snprintf(token, sizeof(token), "%.*s", end - begin, feed->buffer + begin);
+        value = strtol(token, &end_of_number, 10);
+        if (*end_of_number != '\0' || end - begin >= (int)sizeof(token)) {
+            fprintf(stderr, "mlqfs: ignoring malformed feed token \"%s\".\n", token);
+            continue;
+        }
+
+        feed->record[feed->tokens ++] = value;
+        if (feed->tokens == FEED_RECORD_SIZE) {
+            memcpy(record, feed->record, sizeof(feed->record));
+            feed->tokens = 0;
+            *start = feed->consumed;
+            feed->consumed = feed->offset + end;
+            found = TRUE;
+        }
+    }
+
+    // discard the parsed bytes.
+    memmove(feed->buffer, feed->buffer + position, feed->length - position);
+    feed->length -= position;
+    feed->offset += position;
+
+    // a full buffer without a single token separator can't be parsed.
+    if (!found && feed->length == FEED_BUFFER_SIZE) {
+        fprintf(stderr, "mlqfs: ignoring %d bytes of malformed feed data.\n", feed->length);
+        feed->offset += feed->length;
+        feed->length = 0;
+    }
+    return found;
+}
+
+
+/**
+ * @brief Close the producer stream.
+ */
+void close_feed(Feed *feed) {
+    if (feed->fd >= 0) { close(feed->fd); }
+    feed->fd = -1;
+    feed->eof = TRUE;
+}
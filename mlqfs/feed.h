@@ -0,0 +1,71 @@
+/**
+ *  feed.h
+ *  mlqfs
+ *
+ *  Non-blocking reader for live process descriptions,
+ *  arriving on a FIFO, a Unix socket or replayed from a file.
+ */
+
+#ifndef feed_h
+#define feed_h
+
+#define FEED_BUFFER_SIZE 4096
+#define FEED_RECORD_SIZE 5
+
+typedef struct Feed {
+    int fd;                             // producer stream, -1 if closed.
+    int eof;                            // the producer is gone, no more data will come.
+    char buffer[FEED_BUFFER_SIZE];      // bytes read but not parsed yet.
+    int length;
+    long record[FEED_RECORD_SIZE];      // tokens of the record being assembled.
+    int tokens;
+    unsigned long long offset;          // stream offset of buffer[0].
+    unsigned long long consumed;        // stream offset right after the last complete record.
+} Feed;
+
+/**
+ * @brief Open a file or FIFO feed
+ * Blocks until a producer opens the FIFO for writing, then switches the
+ * stream to non-blocking mode.
+ * @returns TRUE on success.
+ */
+int open_file_feed(Feed *feed, const char *path);
+
+/**
+ * @brief Open a Unix socket feed
+ * Binds a stream socket at 'path' and blocks until one producer connects.
+ * The feed ends when that producer disconnects.
+ * @returns TRUE on success.
+ */
+int open_socket_feed(Feed *feed, const char *path);
+
+/**
+ * @brief Move the feed to a stream offset, used when resuming from a checkpoint.
+ * @returns TRUE if the stream is seekable.
+ */
+int seek_feed(Feed *feed, unsigned long long offset);
+
+/**
+ * @brief Read whatever the producer has written
+ * Waits at most 'timeout' milliseconds for data (negative waits forever,
+ * 0 only polls). Once the feed has ended, simply sleeps for the timeout.
+ */
+void poll_feed(Feed *feed, int timeout);
+
+/**
+ * @brief Extract the next complete record from the buffered data
+ * A record is FEED_RECORD_SIZE whitespace separated integers, newlines are
+ * not significant, like the fscanf based batch loader.
+ *
+ * @param record receives the record values.
+ * @param start receives the stream offset from which the record can be read again.
+ * @returns TRUE if a record was extracted.
+ */
+int next_feed_record(Feed *feed, long record[FEED_RECORD_SIZE], unsigned long long *start);
+
+/**
+ * @brief Close the producer stream.
+ */
+void close_feed(Feed *feed);
+
+#endif /* feed_h */
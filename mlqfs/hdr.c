@@ -0,0 +1,111 @@
+/**
+ *  hdr.c
+ *  mlqfs
+ *
+ *  Fixed memory, log bucketed histograms of tick durations.
+ */
+
+#include <string.h>
+#include "hdr.h"
+
+#define HDR_HALF_SUB_BUCKETS (HDR_SUB_BUCKETS / 2)
+
+
+/**
+ * @brief Bucket of a value
+ * Values under HDR_SUB_BUCKETS have their own bucket. Above, the value is
+ * shifted right until it fits in HDR_SUB_BUCKET_BITS bits, and the shift
+ * selects the half of the buckets range it lands in.
+ */
+static int bucket_index(unsigned int value) {
+    int shift;
+    if (value < HDR_SUB_BUCKETS) { return (int)value; }
+    shift = (31 - __builtin_clz(value)) - HDR_SUB_BUCKET_BITS + 1;
+    return shift * HDR_HALF_SUB_BUCKETS + (int)(value >> shift);
+}
+
+
+unsigned int bucket_lowest_value(int index) {
+    int shift;
+    if (index < HDR_SUB_BUCKETS) { return (unsigned int)index; }
+    shift = index / HDR_HALF_SUB_BUCKETS - 1;
+    return (unsigned int)(index - shift * HDR_HALF_SUB_BUCKETS) << shift;
+}
+
+
+unsigned int bucket_highest_value(int index) {
+    int shift;
+    if (index < HDR_SUB_BUCKETS) { return (unsigned int)index; }
+    shift = index / HDR_HALF_SUB_BUCKETS - 1;
+    return (unsigned int)((((unsigned long long)(index - shift * HDR_HALF_SUB_BUCKETS) + 1) << shift) - 1);
+}
+
+
+void init_histogram(Histogram *histogram) {
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+
+void record_value(Histogram *histogram, unsigned int value) {
+    if (histogram->total == 0 || value < histogram->min) { histogram->min = value; }
+    if (value > histogram->max) { histogram->max = value; }
+    histogram->counts[bucket_index(value)] ++;
+    histogram->total ++;
+    histogram->sum += value;
+}
+
+
+void merge_histogram(Histogram *into, const Histogram *from) {
+    if (from->total == 0) { return; }
+    if (into->total == 0 || from->min < into->min) { into->min = from->min; }
+    if (from->max > into->max) { into->max = from->max; }
+    for (int i = 0; i < HDR_BUCKETS; i ++) { into->counts[i] += from->counts[i]; }
+    into->total += from->total;
+    into->sum += from->sum;
+}
+
+
+unsigned int histogram_percentile(const Histogram *histogram, double percentile) {
+    unsigned long long rank, seen = 0;
+
+    if (histogram->total == 0) { return 0; }
+    rank = (unsigned long long)(percentile / 100 * histogram->total + 0.5);
+    if (rank < 1) { rank = 1; }
+
+    for (int i = 0; i < HDR_BUCKETS; i ++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            unsigned int value = bucket_highest_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+
+double histogram_mean(const Histogram *histogram) {
+    return histogram->total > 0 ? (double)histogram->sum / histogram->total : 0;
+}
+
+
+void print_histogram(FILE *stream, const char *name, const Histogram *histogram) {
+    fprintf(stream, "%-14s %10llu %10.1f %8u %8u %8u %8u %8u %8u\n", name, histogram->total, histogram_mean(histogram),
+            histogram->min, histogram_percentile(histogram, 50), histogram_percentile(histogram, 90),
+            histogram_percentile(histogram, 99), histogram_percentile(histogram, 99.9), histogram->max);
+}
+
+
+void print_histogram_json(FILE *stream, const Histogram *histogram) {
+    int first = 1;
+
+    fprintf(stream, "{\"count\": %llu, \"mean\": %.3f, \"min\": %u, \"p50\": %u, \"p90\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u, \"buckets\": [",
+            histogram->total, histogram_mean(histogram), histogram->min, histogram_percentile(histogram, 50),
+            histogram_percentile(histogram, 90), histogram_percentile(histogram, 99), histogram_percentile(histogram, 99.9),
+            histogram->max);
+    for (int i = 0; i < HDR_BUCKETS; i ++) {
+        if (histogram->counts[i] == 0) { continue; }
+        fprintf(stream, "%s[%u, %u, %llu]", first ? "" : ", ", bucket_lowest_value(i), bucket_highest_value(i), histogram->counts[i]);
+        first = 0;
+    }
+    fprintf(stream, "]}");
+}
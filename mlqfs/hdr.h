@@ -0,0 +1,66 @@
+/**
+ *  hdr.h
+ *  mlqfs
+ *
+ *  Fixed memory, log bucketed histograms of tick durations, in the spirit of
+ *  HdrHistogram: every power of two range is split in HDR_SUB_BUCKETS / 2
+ *  linear buckets, so any recorded value is known within 1 / 16 of itself
+ *  over the whole unsigned int range. Recording is a few shifts and an
+ *  increment, and histograms of the same layout merge by adding counts.
+ */
+
+#ifndef hdr_h
+#define hdr_h
+
+#include <stdio.h>
+
+#define HDR_SUB_BUCKET_BITS 5
+#define HDR_SUB_BUCKETS (1 << HDR_SUB_BUCKET_BITS)
+#define HDR_BUCKETS ((32 - HDR_SUB_BUCKET_BITS + 2) * (HDR_SUB_BUCKETS / 2))
+
+typedef struct Histogram {
+    unsigned long long counts[HDR_BUCKETS];
+    unsigned long long total;       // number of recorded values.
+    unsigned long long sum;         // sum of the recorded values, for the mean.
+    unsigned int min;
+    unsigned int max;
+} Histogram;
+
+void init_histogram(Histogram *histogram);
+
+/**
+ * @brief Record one value.
+ */
+void record_value(Histogram *histogram, unsigned int value);
+
+/**
+ * @brief Add the counts of 'from' to 'into'.
+ */
+void merge_histogram(Histogram *into, const Histogram *from);
+
+/**
+ * @brief Value at a percentile, in [0, 100]
+ * @returns the highest value equivalent to the bucket holding the percentile,
+ * clamped to the recorded maximum, or 0 if the histogram is empty.
+ */
+unsigned int histogram_percentile(const Histogram *histogram, double percentile);
+
+double histogram_mean(const Histogram *histogram);
+
+/**
+ * @brief Bounds of the values counted in a bucket.
+ */
+unsigned int bucket_lowest_value(int index);
+unsigned int bucket_highest_value(int index);
+
+/**
+ * @brief Print a one line percentile summary.
+ */
+void print_histogram(FILE *stream, const char *name, const Histogram *histogram);
+
+/**
+ * @brief Print a histogram as a JSON object with its summary and non empty buckets.
+ */
+void print_histogram_json(FILE *stream, const Histogram *histogram);
+
+#endif /* hdr_h */
@@ -0,0 +1,123 @@
+/**
+ *  hwperf.c
+ *  mlqfs
+ *
+ *  Hardware performance counters around the simulation phases.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "prioque.h"
+#include "hwperf.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static const unsigned long long event_configs[HWPERF_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+};
+#endif
+
+static const char *event_names[HWPERF_EVENTS] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+
+/**
+ * @brief Open the counters, disabled
+ * Events are opened one by one for user space only, so a machine lacking
+ * one event (common for cache misses in virtual machines) still gets the others.
+ * @returns the number of events opened.
+ */
+int open_hardware_counters(HardwareCounters *counters) {
+    int opened = 0;
+
+    counters->error = 0;
+    for (int i = 0; i < HWPERF_EVENTS; i ++) {
+        counters->fds[i] = -1;
+#if defined(__linux__)
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = event_configs[i];
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+        if (counters->fds[i] < 0) {
+            counters->fds[i] = -1;
+            if (counters->error == 0) { counters->error = errno; }
+        } else {
+            opened ++;
+        }
+#else
+        counters->error = ENOSYS;
+#endif
+    }
+    return opened;
+}
+
+
+/**
+ * @brief Reset and enable the counters at the start of a phase.
+ */
+void start_hardware_counters(HardwareCounters *counters) {
+#if defined(__linux__)
+    for (int i = 0; i < HWPERF_EVENTS; i ++) {
+        if (counters->fds[i] < 0) { continue; }
+        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+
+/**
+ * @brief Disable the counters at the end of a phase and read them
+ * Counts are scaled up if the kernel had to multiplex the events.
+ */
+void stop_hardware_counters(HardwareCounters *counters, HardwareReading *reading) {
+    for (int i = 0; i < HWPERF_EVENTS; i ++) {
+        reading->values[i] = 0;
+        reading->valid[i] = FALSE;
+#if defined(__linux__)
+        unsigned long long data[3];     // value, time enabled, time running.
+
+        if (counters->fds[i] < 0) { continue; }
+        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counters->fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) { continue; }
+        reading->values[i] = data[2] < data[1] ? (unsigned long long)((double)data[0] * data[1] / data[2]) : data[0];
+        reading->valid[i] = TRUE;
+#endif
+    }
+}
+
+
+/**
+ * @brief Print one phase reading as a line of name=value pairs, "n/a" for missing events.
+ */
+void print_hardware_reading(FILE *stream, const char *phase, HardwareReading *reading) {
+    fprintf(stream, "hwperf: phase=%s", phase);
+    for (int i = 0; i < HWPERF_EVENTS; i ++) {
+        if (reading->valid[i]) {
+            fprintf(stream, " %s=%llu", event_names[i], reading->values[i]);
+        } else {
+            fprintf(stream, " %s=n/a", event_names[i]);
+        }
+    }
+    if (reading->valid[HWPERF_CYCLES] && reading->valid[HWPERF_INSTRUCTIONS] && reading->values[HWPERF_CYCLES] > 0) {
+        fprintf(stream, " ipc=%.2f", (double)reading->values[HWPERF_INSTRUCTIONS] / reading->values[HWPERF_CYCLES]);
+    }
+    fprintf(stream, "\n");
+}
+
+
+void close_hardware_counters(HardwareCounters *counters) {
+    for (int i = 0; i < HWPERF_EVENTS; i ++) {
+        if (counters->fds[i] >= 0) { close(counters->fds[i]); }
+        counters->fds[i] = -1;
+    }
+}
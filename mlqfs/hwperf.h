@@ -0,0 +1,54 @@
+/**
+ *  hwperf.h
+ *  mlqfs
+ *
+ *  Hardware performance counters (cycles, instructions, cache and branch
+ *  misses) of the calling thread, with perf_event_open on Linux.
+ *  Elsewhere, or when the kernel does not permit them, counters are
+ *  simply reported as unavailable.
+ */
+
+#ifndef hwperf_h
+#define hwperf_h
+
+#include <stdio.h>
+
+enum { HWPERF_CYCLES, HWPERF_INSTRUCTIONS, HWPERF_CACHE_MISSES, HWPERF_BRANCH_MISSES, HWPERF_EVENTS };
+
+typedef struct HardwareCounters {
+    int fds[HWPERF_EVENTS];     // one event each, -1 if it could not be opened.
+    int error;                  // errno of the first event which failed to open, 0 if none did.
+} HardwareCounters;
+
+typedef struct HardwareReading {
+    unsigned long long values[HWPERF_EVENTS];
+    int valid[HWPERF_EVENTS];   // FALSE if the event is not available.
+} HardwareReading;
+
+/**
+ * @brief Open the counters, disabled
+ * Events are opened one by one for user space only, so a machine lacking
+ * one event (common for cache misses in virtual machines) still gets the others.
+ * @returns the number of events opened.
+ */
+int open_hardware_counters(HardwareCounters *counters);
+
+/**
+ * @brief Reset and enable the counters at the start of a phase.
+ */
+void start_hardware_counters(HardwareCounters *counters);
+
+/**
+ * @brief Disable the counters at the end of a phase and read them
+ * Counts are scaled up if the kernel had to multiplex the events.
+ */
+void stop_hardware_counters(HardwareCounters *counters, HardwareReading *reading);
+
+/**
+ * @brief Print one phase reading as a line of name=value pairs, "n/a" for missing events.
+ */
+void print_hardware_reading(FILE *stream, const char *phase, HardwareReading *reading);
+
+void close_hardware_counters(HardwareCounters *counters);
+
+#endif /* hwperf_h */
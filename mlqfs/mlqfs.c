@@ -6,20 +6,36 @@
  *  Copyright © 2019 piergabory. All rights reserved.
  */
 
+#include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <string.h>
+#include <time.h>
 #include "mlqfs.h"
-
-#define MAX_PRIORITY 0
-#define MIN_PRIORITY 2
-
-static const int QUANTUM_THRESHOLD[3] = { 10, 30, 100 };
-static const int DEMOTION_THRESHOLD[3] = { 1, 2, 'X' };
-static const int PROMOTION_THRESHOLD[3] = { 'X', 2, 1 };
+#include "checkpoint.h"
+#include "feed.h"
+#include "policy.h"
+#include "burner.h"
+#include "stats.h"
+#include "hdr.h"
+#include "series.h"
+#include "trace.h"
+#include "hwperf.h"
+
+static int quantum_threshold[LEVELS] = DEFAULT_QUANTUM_THRESHOLD;    // what-if branches may change it.
 
 static Queue ready_queue;       // Processes waiting for CPU time.
 static Queue io_queue;        // Processes in IO. 
 static Queue arrival_queue;   // Processes waiting for their arrival time.
 static Queue logs;    // Terminated processes buffer, used in the report output.
 
+// Processes moved at once from the arrival or io queue to the ready queue.
+#define DRAIN_BATCH 32
+
 // Define the null process used in the report output.
 static Process null = { .pid = 0, .total_cpu_usage = 0 }; 
 
@@ -31,6 +47,79 @@ static FILE* output = NULL;
 
 static Process running;
 
+// Checkpointing: snapshot interval in ticks (0 disables) and destination file.
+static unsigned int checkpoint_interval = 0;
+static const char *checkpoint_path = "mlqfs.ckpt";
+
+// Writer process of the last checkpoint, still running or not yet reaped.
+static pid_t checkpoint_writer = 0;
+
+// Number of input bytes already parsed into the arrival queue.
+static unsigned long long input_offset = 0;
+
+// Live mode: process descriptions streamed by a producer while the scheduler runs.
+static int live = FALSE;
+static Feed feed;
+static double ticks_per_ms = 0;     // wall-clock pacing, 0 runs free.
+
+// Live process still being described by the feed, and where its description started.
+static Process pending;
+static int has_pending = FALSE;
+static unsigned long long pending_offset = 0;
+
+// Real mode: every process is backed by a burner child granted one tick of wall time at a time.
+static int real = FALSE;
+static long long tick_ns = 0;
+static const char *burner_command = NULL;   // NULL spins on the CPU.
+
+// Latency of the terminated processes, summarized as they terminate.
+static Summary response_summary;
+static Summary waiting_summary;
+static Summary turnaround_summary;
+
+// Distributions per level: wait in the ready queue before each RUN, and scheduled I/O durations.
+static Histogram run_wait_histogram[LEVELS];
+static Histogram io_wait_histogram[LEVELS];
+static const char *histogram_path = NULL;   // NULL doesn't dump them.
+
+// Occupancy time series: length of each level, kept up to date as processes move.
+static unsigned int ready_length[LEVELS];
+static unsigned int io_length[LEVELS];      // by the level processes return to.
+static unsigned int sample_interval = 0;    // ticks between samples, 0 disables the series.
+static const char *series_path = "mlqfs.csv";
+static Series series;
+static unsigned int sampled_null_ticks = 0; // null process ticks of the interval being sampled.
+
+// Chrome trace of the schedule, written as it happens.
+static Trace trace = { .stream = NULL };
+static const char *trace_path = NULL;       // NULL doesn't trace.
+
+// Performance summary: events logged, and whether to print the summary.
+static unsigned long long event_count = 0;
+static int perf_summary = FALSE;
+
+// Hardware counters of the load, simulation and report phases.
+enum { LOAD_PHASE, SIMULATION_PHASE, REPORT_PHASE, PHASES };
+static const char *phase_names[PHASES] = { "load", "simulation", "report" };
+static int hardware_summary = FALSE;
+static HardwareCounters hardware_counters;
+static HardwareReading hardware_readings[PHASES];
+
+#if defined(MLQFS_COUNTERS)
+// Hot path counters, compiled in with -DMLQFS_COUNTERS and printed at exit.
+static struct {
+    unsigned long long ticks;                   // simulated one by one.
+    unsigned long long fast_forwarded_ticks;    // skipped while idle.
+    unsigned long long schedule_iterations;     // passes of the schedule_processes() loop.
+    unsigned long long schedule_iterations_max; // most passes in one tick.
+} counters;
+#define COUNT(counter, n) (counters.counter += (n))
+#define COUNT_MAX(counter, value) do { if ((value) > counters.counter) { counters.counter = (value); } } while (0)
+#else
+#define COUNT(counter, n) ((void)0)
+#define COUNT_MAX(counter, value) ((void)0)
+#endif
+
 
 /**
  * @brief compare two processes struct
@@ -49,15 +138,92 @@ int process_compare(void* lhs, void* rhs) {
 }
 
 
+/**
+ * @brief Log a scheduling event in the output stream.
+ */
+static void log_event(const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    vfprintf(output, format, arguments);
+    va_end(arguments);
+    event_count ++;
+}
+
+
 /**
  * @brief MLQFScheduler initializer
  * call initializer function for each queues
  * representing the state of the scheduler
  */
 void init_scheduler() {
-    init_queue(&ready_queue, sizeof(Process), FALSE, process_compare, FALSE);
-    init_queue(&io_queue, sizeof(Process), FALSE, process_compare, FALSE);
+    init_queue(&arrival_queue, sizeof(Process), FALSE, process_compare, FALSE);
+    // a process is in one of the ready and io queues at a time, so they skip
+    // the search for duplicates and requeue to the rear of a level directly.
+    init_queue(&ready_queue, sizeof(Process), TRUE, process_compare, FALSE);
+    init_queue(&io_queue, sizeof(Process), TRUE, process_compare, FALSE);
     init_queue(&logs, sizeof(Process), FALSE, process_compare, FALSE);
+    init_summary(&response_summary);
+    init_summary(&waiting_summary);
+    init_summary(&turnaround_summary);
+    for (int level = 0; level < LEVELS; level ++) {
+        init_histogram(&run_wait_histogram[level]);
+        init_histogram(&io_wait_histogram[level]);
+        ready_length[level] = 0;
+        io_length[level] = 0;
+    }
+}
+
+
+/**
+ * @brief Dump the latency histograms
+ * Writes a percentile table to histogram_path and the histograms with
+ * their buckets as JSON to "[histogram_path].json".
+ */
+static void dump_histograms() {
+    Histogram *histograms[2] = { run_wait_histogram, io_wait_histogram };
+    const char *names[2] = { "run wait", "io wait" };
+    const char *keys[2] = { "run_wait", "io_wait" };
+    char json_path[1024], name[32];
+    FILE *text, *json;
+
+    snprintf(json_path, sizeof(json_path), "%s.json", histogram_path);
+    text = fopen(histogram_path, "w");
+    json = fopen(json_path, "w");
+    if (text == NULL || json == NULL) {
+        perror("mlqfs: histograms");
+        if (text != NULL) { fclose(text); }
+        if (json != NULL) { fclose(json); }
+        return;
+    }
+
+    fprintf(text, "Latency histograms at time %u, in time units.\n\n", mlqfs_clock);
+    fprintf(text, "%-14s %10s %10s %8s %8s %8s %8s %8s %8s\n", "event", "count", "mean", "min", "p50", "p90", "p99", "p99.9", "max");
+    fprintf(json, "{\"clock\": %u", mlqfs_clock);
+
+    for (int event = 0; event < 2; event ++) {
+        Histogram all;
+        init_histogram(&all);
+        fprintf(json, ", \"%s\": {", keys[event]);
+
+        for (int level = 0; level < LEVELS; level ++) {
+            snprintf(name, sizeof(name), "%s L%d", names[event], level + 1);
+            print_histogram(text, name, &histograms[event][level]);
+            fprintf(json, "\"level%d\": ", level + 1);
+            print_histogram_json(json, &histograms[event][level]);
+            fprintf(json, ", ");
+            merge_histogram(&all, &histograms[event][level]);
+        }
+
+        snprintf(name, sizeof(name), "%s all", names[event]);
+        print_histogram(text, name, &all);
+        fprintf(json, "\"all\": ");
+        print_histogram_json(json, &all);
+        fprintf(json, "}");
+    }
+    fprintf(json, "}\n");
+
+    fclose(text);
+    fclose(json);
 }
 
 
@@ -66,6 +232,7 @@ void init_scheduler() {
  * free the memory for all the scheduler state queues.
  * saves the null process logs.
  * logs the shutdown time.
+ * dumps the latency histograms if requested.
  */
 void shutdown_scheduler() {
     destroy_queue(&ready_queue);
@@ -78,6 +245,8 @@ void shutdown_scheduler() {
     }
 
     fprintf(output, "Scheduler shutdown at time %u.\n", mlqfs_clock);
+
+    if (histogram_path != NULL) { dump_histograms(); }
 }
 
 
@@ -96,6 +265,18 @@ void init_process(Process *process) {
     process->promotion = 0;
     process->demotion = 0;
     process->total_cpu_usage = 0;
+    process->burner = 0;
+    process->burner_exited = FALSE;
+    process->cpu_time = 0;
+    process->created_at = 0;
+    process->finished_at = 0;
+    process->started = FALSE;
+    process->blocked_time = 0;
+    process->io_ticks = 0;
+    process->response_time = 0;
+    process->waiting_time = 0;
+    process->turnaround_time = 0;
+    process->ready_since = 0;
 
     init_queue(&process->behaviours, sizeof(Behaviour), TRUE, NULL, FALSE);
 }
@@ -105,10 +286,12 @@ void init_process(Process *process) {
  * @brief Check the activity of the MLQFScheduler
  * the scheduler is considered active as long as there
  * is an active process running, waiting io, or waiting to start.
+ * In live mode, it also stays active until the producer closes the feed.
  * @return boolean
  */
 int scheduler_is_active() {
-    return (queue_length(&ready_queue) > 0) || (queue_length(&io_queue) > 0) || (queue_length(&arrival_queue) > 0);
+    return (queue_length(&ready_queue) > 0) || (queue_length(&io_queue) > 0) || (queue_length(&arrival_queue) > 0)
+        || has_pending || (live && !feed.eof);
 }
 
 
@@ -128,7 +311,6 @@ void load_process_descriptions(FILE* input) {
     unsigned int arrival;
 
     init_process(&process);
-    init_queue(&arrival_queue, sizeof(Process), FALSE, process_compare, FALSE);
     arrival = 0;
 
     while (fscanf(input, "%u", &arrival) != EOF) {
@@ -145,7 +327,115 @@ void load_process_descriptions(FILE* input) {
         add_to_queue(&process.behaviours, &behaviour, 1);
     }
 
-    add_to_queue(&arrival_queue, &process, process.arrival_time);
+    // an empty stream (or a resumed one already consumed) describes no process.
+    if (!is_first) {
+        add_to_queue(&arrival_queue, &process, process.arrival_time);
+    }
+
+    // remember how far the stream was consumed, pipes cannot report it.
+    long position = ftell(input);
+    if (position > 0) { input_offset = position; }
+}
+
+
+/**
+ * @brief Load live process descriptions
+ * Parses the records buffered by the live feed, with the same format as
+ * load_process_descriptions(). Consecutive records of one PID describe one
+ * process, which is pushed in the arrival queue once a record of another
+ * PID follows, the feed ends, or its arrival time is reached: descriptions
+ * must be complete before the process arrives.
+ */
+void accept_live_processes() {
+    long record[FEED_RECORD_SIZE];
+    unsigned long long start;
+    Behaviour behaviour;
+
+    while (next_feed_record(&feed, record, &start)) {
+        if (has_pending && pending.pid != (int)record[1]) {
+            add_to_queue(&arrival_queue, &pending, pending.arrival_time);
+            has_pending = FALSE;
+        }
+        if (!has_pending) {
+            init_process(&pending);
+            pending.pid = (int)record[1];
+            pending_offset = start;
+            has_pending = TRUE;
+        }
+        pending.arrival_time = (unsigned int)record[0];
+        behaviour.cpu_time = (unsigned int)record[2];
+        behaviour.io_time = (unsigned int)record[3];
+        behaviour.repeats = (unsigned int)record[4];
+        add_to_queue(&pending.behaviours, &behaviour, 1);
+    }
+
+    if (has_pending && (feed.eof || pending.arrival_time <= mlqfs_clock)) {
+        add_to_queue(&arrival_queue, &pending, pending.arrival_time);
+        has_pending = FALSE;
+    }
+
+    // a resumed run must read the pending description again.
+    input_offset = has_pending ? pending_offset : feed.consumed;
+}
+
+
+/**
+ * @brief Wait for the next live tick
+ * Reads the feed until the tick is due: free running, it only blocks while
+ * there is nothing to simulate; paced, ticks are spread at ticks_per_ms
+ * against the wall clock, measured from the first paced tick.
+ */
+static void wait_for_tick() {
+    static struct timespec origin;
+    static unsigned int origin_clock;
+    static int paced = FALSE;
+    struct timespec now;
+    double elapsed, due;
+
+    if (ticks_per_ms <= 0) {
+        int idle = !has_pending && queue_length(&ready_queue) == 0
+            && queue_length(&io_queue) == 0 && queue_length(&arrival_queue) == 0;
+        // events must be out before blocking on the producer.
+        if (idle) { fflush(output); }
+        poll_feed(&feed, idle ? -1 : 0);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!paced) {
+        origin = now;
+        origin_clock = mlqfs_clock;
+        paced = TRUE;
+    }
+
+    due = (mlqfs_clock - origin_clock) / ticks_per_ms;
+    for (;;) {
+        elapsed = (now.tv_sec - origin.tv_sec) * 1e3 + (now.tv_nsec - origin.tv_nsec) / 1e6;
+        if (elapsed >= due) { break; }
+        poll_feed(&feed, (int)(due - elapsed) + 1);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+    poll_feed(&feed, 0);
+}
+
+
+static long long wall_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+/**
+ * @brief Back a newly created process with a stopped burner child, in real mode.
+ */
+static void start_burner(Process *process) {
+    process->burner = spawn_burner(burner_command);
+    if (process->burner < 0) {
+        perror("mlqfs: burner");
+        exit(1);
+    }
+    process->created_at = wall_time();
 }
 
 
@@ -159,6 +449,8 @@ void load_process_descriptions(FILE* input) {
  */
 void queue_new_processes() {
     Process process, previous_active = null;
+    Process batch[DRAIN_BATCH];
+    int count;
 
     // save current active process pid
     if (queue_length(&ready_queue) > 0) {
@@ -166,26 +458,43 @@ void queue_new_processes() {
         previous_active.priority_cache = current_priority(&ready_queue);
     }
 
-    // schedule arrival processes.
-    while (queue_length(&arrival_queue) > 0 && current_priority(&arrival_queue) <= mlqfs_clock) {
-        remove_from_front(&arrival_queue, &process);
-        add_to_queue(&ready_queue, &process, MAX_PRIORITY);
-        fprintf(output, "CREATE: Process %d entered the ready queue at time %d.\n", process.pid, mlqfs_clock);
+    // schedule arrival processes, drained a batch at a time.
+    count = DRAIN_BATCH;
+    while (count == DRAIN_BATCH && queue_length(&arrival_queue) > 0) {
+        count = remove_while_priority_le(&arrival_queue, (int)mlqfs_clock, batch, DRAIN_BATCH);
+        for (int i = 0; i < count; i ++) {
+            process = batch[i];
+            if (real) { start_burner(&process); }
+            process.ready_since = mlqfs_clock;
+            add_to_queue(&ready_queue, &process, MAX_PRIORITY);
+            ready_length[MAX_PRIORITY] ++;
+            trace_create(&trace, mlqfs_clock, process.pid);
+            log_event("CREATE: Process %d entered the ready queue at time %d.\n", process.pid, mlqfs_clock);
+        }
     }
 
     // return io processes to cpu.
-    while (queue_length(&io_queue) > 0 && current_priority(&io_queue) <= mlqfs_clock) {
-        remove_from_front(&io_queue, &process);
-        add_to_queue(&ready_queue, &process, process.priority_cache);
-        // log queueing when leaving io
-        fprintf(output, "QUEUED: Process %d queued at level %d at time %u.\n", process.pid, process.priority_cache + 1, mlqfs_clock);
+    count = DRAIN_BATCH;
+    while (count == DRAIN_BATCH && queue_length(&io_queue) > 0) {
+        count = remove_while_priority_le(&io_queue, (int)mlqfs_clock, batch, DRAIN_BATCH);
+        for (int i = 0; i < count; i ++) {
+            process = batch[i];
+            process.io_ticks += mlqfs_clock - process.blocked_time;
+            process.ready_since = mlqfs_clock;
+            add_to_queue(&ready_queue, &process, process.priority_cache);
+            io_length[process.priority_cache] --;
+            ready_length[process.priority_cache] ++;
+            trace_io(&trace, process.blocked_time, mlqfs_clock, process.pid);
+            // log queueing when leaving io
+            log_event("QUEUED: Process %d queued at level %d at time %u.\n", process.pid, process.priority_cache + 1, mlqfs_clock);
+        }
     }
 
     // log preemption
     if (queue_length(&ready_queue) > 0 && previous_active.pid != null.pid) {
         peek_at_current(&ready_queue, &process);
         if (previous_active.pid != process.pid) {
-            fprintf(output, "QUEUED: Process %d queued at level %d at time %u.\n", previous_active.pid, previous_active.priority_cache + 1, mlqfs_clock);
+            log_event("QUEUED: Process %d queued at level %d at time %u.\n", previous_active.pid, previous_active.priority_cache + 1, mlqfs_clock);
         }
     }
 }
@@ -204,7 +513,9 @@ void send_process_to_io() {
     Behaviour behaviour;
     int priority = current_priority(&ready_queue);
     remove_from_front(&ready_queue, &process);
+    ready_length[priority] --;
     peek_at_current(&process.behaviours, &behaviour);
+    record_value(&io_wait_histogram[priority], behaviour.io_time);
 
     process.promotion ++;
     process.demotion = 0;
@@ -212,7 +523,10 @@ void send_process_to_io() {
     // promote process
     if (process.promotion >= PROMOTION_THRESHOLD[priority]) {
         process.promotion = 0;
-        if (priority != MAX_PRIORITY) { priority --; }
+        if (priority != MAX_PRIORITY) {
+            priority --;
+            trace_level(&trace, mlqfs_clock, process.pid, priority + 1, priority);
+        }
     }
 
     // store priority in the process struct.
@@ -221,9 +535,11 @@ void send_process_to_io() {
     process.progress ++;
     process.units = 0;
     process.quanta = 0;
+    process.blocked_time = mlqfs_clock;
 
     add_to_queue(&io_queue, &process, mlqfs_clock + behaviour.io_time);
-    fprintf(output, "I/O: Process %d blocked for I/O at time %u.\n", process.pid, mlqfs_clock);
+    io_length[priority] ++;
+    log_event("I/O: Process %d blocked for I/O at time %u.\n", process.pid, mlqfs_clock);
 }
 
 
@@ -238,6 +554,7 @@ void halt_process() {
     Process process;
     int priority = current_priority(&ready_queue);
     remove_from_front(&ready_queue, &process);
+    ready_length[priority] --;
     process.demotion ++;
     process.promotion = 0;
     process.quanta = 0;
@@ -245,11 +562,15 @@ void halt_process() {
     // demote process
     if (process.demotion >= DEMOTION_THRESHOLD[priority]) {
         process.demotion = 0;
-        if (priority != MIN_PRIORITY) { priority ++; }
+        if (priority != MIN_PRIORITY) {
+            priority ++;
+            trace_level(&trace, mlqfs_clock, process.pid, priority - 1, priority);
+        }
     }
 
     add_to_queue(&ready_queue, &process, priority);
-    fprintf(output, "QUEUED: Process %d queued at level %d at time %u.\n", process.pid, priority + 1, mlqfs_clock);
+    ready_length[priority] ++;
+    log_event("QUEUED: Process %d queued at level %d at time %u.\n", process.pid, priority + 1, mlqfs_clock);
 }
 
 
@@ -260,10 +581,25 @@ void halt_process() {
  */
 void terminate_process() {
     Process process;
+    ready_length[current_priority(&ready_queue)] --;
     remove_from_front(&ready_queue, &process);
     destroy_queue(&process.behaviours);
+    if (real) {
+        if (!process.burner_exited) { kill_burner(process.burner); }
+        process.finished_at = wall_time();
+    }
+
+    // whatever isn't spent running or in I/O was spent waiting in the ready queue.
+    process.turnaround_time = mlqfs_clock - process.arrival_time;
+    process.waiting_time = process.turnaround_time - process.io_ticks;
+    process.waiting_time = process.waiting_time > process.total_cpu_usage ? process.waiting_time - process.total_cpu_usage : 0;
+    add_sample(&response_summary, process.response_time);
+    add_sample(&waiting_summary, process.waiting_time);
+    add_sample(&turnaround_summary, process.turnaround_time);
+
     add_to_queue(&logs, &process, process.total_cpu_usage);
-    fprintf(output, "FINISHED: Process %d finished at time %u.\n", process.pid, mlqfs_clock);
+    trace_finish(&trace, mlqfs_clock, process.pid);
+    log_event("FINISHED: Process %d finished at time %u.\n", process.pid, mlqfs_clock);
 }
 
 
@@ -274,9 +610,11 @@ void schedule_processes() {
     Process process;
     Behaviour behaviour;
     int priority;
+    unsigned long long iterations = 0;
 
     // looks at the top process, and while it's not eligible for a cpu unit, it will be rescheduled.
     while (queue_length(&ready_queue) > 0) {
+        iterations ++;
         peek_at_current(&ready_queue, &process);
         priority = current_priority(&ready_queue);
         peek_at_current(&process.behaviours, &behaviour);
@@ -308,14 +646,62 @@ void schedule_processes() {
             // process is starting a new cpu cycle
             if (process.quanta == 0 || process.pid != running.pid) {
                 int time_left = behaviour.cpu_time - process.units;
-                fprintf(output, "RUN: Process %d started execution from level %d at time %u; wants to execute for %u ticks.\n", process.pid, priority + 1, mlqfs_clock, time_left);
+                log_event("RUN: Process %d started execution from level %d at time %u; wants to execute for %u ticks.\n", process.pid, priority + 1, mlqfs_clock, time_left);
+                record_value(&run_wait_histogram[priority], mlqfs_clock - process.ready_since);
+                trace_run(&trace, mlqfs_clock, process.pid, priority);
+            }
+            if (!process.started) {
+                process.started = TRUE;
+                process.response_time = mlqfs_clock - process.arrival_time;
+                update_current(&ready_queue, &process);
             }
             running = process;
+            COUNT(schedule_iterations, iterations);
+            COUNT_MAX(schedule_iterations_max, iterations);
             return;
         }
     }
 
     running = null;
+    COUNT(schedule_iterations, iterations);
+    COUNT_MAX(schedule_iterations_max, iterations);
+}
+
+
+/**
+ * @brief Give one tick to the top process, updated in place in the ready queue.
+ */
+static int run_tick(void *element, int priority, void *context) {
+    Process *process = element;
+    long long used = -1;
+    (void)priority;
+    (void)context;
+
+    if (real && !process->burner_exited) {
+        used = grant_tick(process->burner, tick_ns);
+        if (used < 0) {
+            process->burner_exited = TRUE;
+            fprintf(stderr, "mlqfs: the burner of process %d exited at time %u, the rest of the process is simulated.\n",
+                    process->pid, mlqfs_clock);
+        }
+    } else if (real) {
+        idle_tick(tick_ns);
+    }
+
+    // Update counters
+    if (used >= 0) {
+        // progress by the CPU time the burner actually got.
+        long long previous = process->cpu_time / tick_ns;
+        process->cpu_time += used;
+        process->units += process->cpu_time / tick_ns - previous;
+        process->total_cpu_usage += process->cpu_time / tick_ns - previous;
+    } else {
+        process->units ++;
+        process->total_cpu_usage ++;
+    }
+    // a preempted process waits from the next tick on.
+    process->ready_since = mlqfs_clock + 1;
+    return 0;
 }
 
 
@@ -328,20 +714,26 @@ void run_top_process() {
     if (queue_length(&ready_queue) == 0) {
         // Run null process
         null.total_cpu_usage ++;
+        trace_idle(&trace, mlqfs_clock);
+        if (real) { idle_tick(tick_ns); }
     }
 
     else {
-        // get process
-        Process process;
-        peek_at_current(&ready_queue, &process);
+        with_front(&ready_queue, run_tick, NULL);
+    }
+}
 
-        // Update counters
-        process.units ++;
-        process.total_cpu_usage ++;
 
-        // save changes
-        update_current(&ready_queue, &process);
-    }
+/**
+ * @brief Count one quantum for the top process, updated in place in the ready queue.
+ * @returns TRUE if the process has consumed the quanta of its level.
+ */
+static int consume_quantum(void *element, int priority, void *context) {
+    Process *process = element;
+    (void)context;
+
+    process->quanta ++;
+    return process->quanta >= quantum_threshold[priority];
 }
 
 
@@ -351,23 +743,23 @@ void check_top_process_quanta() {
         return;
     }
 
-
-    // get process
-    Process process;
-    peek_at_current(&ready_queue, &process);
-    process.quanta ++;
-    update_current(&ready_queue, &process);
-    int priority = current_priority(&ready_queue);
-
     // Process has consumed its quanta
-    if (process.quanta >= QUANTUM_THRESHOLD[priority]) {
+    if (with_front(&ready_queue, consume_quantum, NULL)) {
         halt_process();
     }
 }
 
 
+static void print_summary(const char *name, Summary *summary) {
+    fprintf(output, "%-10s : mean %.1f, p50 %.1f, p99 %.1f, max %.0f.\n", name, summary_mean(summary),
+            quantile_value(&summary->p50), quantile_value(&summary->p99), summary->max);
+}
+
+
 /**
  * @brief prints formated output of total cpu usage of every processes, NULL inluded.
+ * Followed by the response, waiting and turnaround times of each process,
+ * and their mean, median, 99th percentile and maximum over all processes.
  */
 void print_report() {
     Process process;
@@ -380,46 +772,878 @@ void print_report() {
             default: fprintf(output, "%d ", process.pid); break;
         }
         fprintf(output, ": %d time units.\n", process.total_cpu_usage);
+        if (real && process.pid != null.pid) {
+            fprintf(output, "    measured: turnaround %.1f ms, cpu %.1f ms%s.\n",
+                    (process.finished_at - process.created_at) / 1e6, process.cpu_time / 1e6,
+                    process.burner_exited ? " until its burner exited" : "");
+        }
+        if (process.pid != null.pid) {
+            fprintf(output, "    latency: response %u, waiting %u, turnaround %u time units.\n",
+                    process.response_time, process.waiting_time, process.turnaround_time);
+        }
+    }
+
+    if (turnaround_summary.count > 0) {
+        fprintf(output, "\nLatency over %llu processes, in time units:\n\n", turnaround_summary.count);
+        print_summary("response", &response_summary);
+        print_summary("waiting", &waiting_summary);
+        print_summary("turnaround", &turnaround_summary);
+    }
+
+    if (real) {
+        struct rusage usage;
+        getrusage(RUSAGE_CHILDREN, &usage);
+        fprintf(output, "\nReal mode, ticks of %.1f us: burners used %.1f ms of CPU in total.\n", tick_ns / 1e3,
+                usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3 + usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3);
     }
     destroy_queue(&logs);
 }
 
 
-int main(int argc, const char * argv[]) {
-    // used for convinient debugging in my IDE
-    if (argc >= 2) {
-        FILE* input = fopen(argv[1], "r");
-        load_process_descriptions(input);
-        fclose(input);
-    } else {
-        load_process_descriptions(stdin);
+/**
+ * @brief Serialize a behaviour, ElementWriter for the behaviours queue.
+ */
+static int write_behaviour(FILE *stream, void *element) {
+    Behaviour *behaviour = element;
+    return write_u32(stream, behaviour->cpu_time)
+        && write_u32(stream, behaviour->io_time)
+        && write_u32(stream, behaviour->repeats);
+}
+
+
+/**
+ * @brief Deserialize a behaviour, ElementReader for the behaviours queue.
+ */
+static int read_behaviour(FILE *stream, void *element) {
+    Behaviour *behaviour = element;
+    return read_u32(stream, &behaviour->cpu_time)
+        && read_u32(stream, &behaviour->io_time)
+        && read_u32(stream, &behaviour->repeats);
+}
+
+
+/**
+ * @brief Serialize the counters of a process, without its behaviours.
+ */
+static int write_process_counters(FILE *stream, Process *process) {
+    return write_u32(stream, process->pid)
+        && write_u32(stream, process->priority_cache)
+        && write_u32(stream, process->arrival_time)
+        && write_u32(stream, process->units)
+        && write_u32(stream, process->quanta)
+        && write_u32(stream, process->progress)
+        && write_u32(stream, process->promotion)
+        && write_u32(stream, process->demotion)
+        && write_u32(stream, process->total_cpu_usage)
+        && write_u32(stream, process->started)
+        && write_u32(stream, process->blocked_time)
+        && write_u32(stream, process->io_ticks)
+        && write_u32(stream, process->response_time)
+        && write_u32(stream, process->waiting_time)
+        && write_u32(stream, process->turnaround_time)
+        && write_u32(stream, process->ready_since);
+}
+
+
+/**
+ * @brief Deserialize the counters of a process, and initialise an empty behaviours queue.
+ */
+static int read_process_counters(FILE *stream, Process *process) {
+    unsigned int pid, priority_cache, started = FALSE;
+    int success;
+    init_process(process);
+    if (!read_u32(stream, &pid) || !read_u32(stream, &priority_cache)) { return FALSE; }
+    process->pid = (int)pid;
+    process->priority_cache = (int)priority_cache;
+    success = read_u32(stream, &process->arrival_time)
+        && read_u32(stream, &process->units)
+        && read_u32(stream, &process->quanta)
+        && read_u32(stream, &process->progress)
+        && read_u32(stream, &process->promotion)
+        && read_u32(stream, &process->demotion)
+        && read_u32(stream, &process->total_cpu_usage)
+        && read_u32(stream, &started)
+        && read_u32(stream, &process->blocked_time)
+        && read_u32(stream, &process->io_ticks)
+        && read_u32(stream, &process->response_time)
+        && read_u32(stream, &process->waiting_time)
+        && read_u32(stream, &process->turnaround_time)
+        && read_u32(stream, &process->ready_since);
+    process->started = (int)started;
+    return success;
+}
+
+
+/**
+ * @brief Serialize a process and its remaining behaviours, ElementWriter for the scheduler queues.
+ */
+static int write_process(FILE *stream, void *element) {
+    Process *process = element;
+    return write_process_counters(stream, process) && write_queue(stream, &process->behaviours, write_behaviour);
+}
+
+
+/**
+ * @brief Deserialize a process and its remaining behaviours, ElementReader for the scheduler queues.
+ */
+static int read_process(FILE *stream, void *element) {
+    Process *process = element;
+    return read_process_counters(stream, process) && read_queue(stream, &process->behaviours, read_behaviour);
+}
+
+
+/**
+ * @brief Serialize the running state of a latency summary.
+ */
+static int write_summary(FILE *stream, Summary *summary) {
+    Quantile *quantiles[2] = { &summary->p50, &summary->p99 };
+    int success = write_u64(stream, summary->count)
+        && write_double(stream, summary->sum)
+        && write_double(stream, summary->max);
+
+    for (int q = 0; q < 2 && success; q ++) {
+        success = write_u64(stream, quantiles[q]->count);
+        for (int i = 0; i < QUANTILE_EXACT_SAMPLES && success; i ++) {
+            success = write_double(stream, quantiles[q]->samples[i]);
+        }
+        for (int i = 0; i < 5 && success; i ++) {
+            success = write_double(stream, quantiles[q]->heights[i])
+                && write_u32(stream, quantiles[q]->positions[i])
+                && write_double(stream, quantiles[q]->desired[i]);
+        }
     }
+    return success;
+}
 
-    if (argc >= 3) {
-        output = fopen(argv[2], "w");
-    } else {
-        output = stdout;
+
+/**
+ * @brief Deserialize a latency summary into an initialised one.
+ */
+static int read_summary(FILE *stream, Summary *summary) {
+    Quantile *quantiles[2] = { &summary->p50, &summary->p99 };
+    int success = read_u64(stream, &summary->count)
+        && read_double(stream, &summary->sum)
+        && read_double(stream, &summary->max);
+
+    for (int q = 0; q < 2 && success; q ++) {
+        success = read_u64(stream, &quantiles[q]->count);
+        for (int i = 0; i < QUANTILE_EXACT_SAMPLES && success; i ++) {
+            success = read_double(stream, &quantiles[q]->samples[i]);
+        }
+        for (int i = 0; i < 5 && success; i ++) {
+            success = read_double(stream, &quantiles[q]->heights[i])
+                && read_u32(stream, (unsigned int *)&quantiles[q]->positions[i])
+                && read_double(stream, &quantiles[q]->desired[i]);
+        }
     }
+    return success;
+}
 
 
+/**
+ * @brief Serialize a histogram, as its non empty buckets.
+ */
+static int write_histogram(FILE *stream, Histogram *histogram) {
+    unsigned int buckets = 0;
+    int success;
+
+    for (int i = 0; i < HDR_BUCKETS; i ++) { buckets += histogram->counts[i] > 0; }
+    success = write_u64(stream, histogram->total)
+        && write_u64(stream, histogram->sum)
+        && write_u32(stream, histogram->min)
+        && write_u32(stream, histogram->max)
+        && write_u32(stream, buckets);
+
+    for (int i = 0; i < HDR_BUCKETS && success; i ++) {
+        if (histogram->counts[i] == 0) { continue; }
+        success = write_u32(stream, i) && write_u64(stream, histogram->counts[i]);
+    }
+    return success;
+}
 
-    // --- BEGIN SCHEDULER ---
-    init_scheduler();
 
-    mlqfs_clock = 0;
+/**
+ * @brief Deserialize a histogram into an initialised one.
+ */
+static int read_histogram(FILE *stream, Histogram *histogram) {
+    unsigned int buckets, index;
+    int success = read_u64(stream, &histogram->total)
+        && read_u64(stream, &histogram->sum)
+        && read_u32(stream, &histogram->min)
+        && read_u32(stream, &histogram->max)
+        && read_u32(stream, &buckets);
+
+    for (unsigned int i = 0; i < buckets && success; i ++) {
+        success = read_u32(stream, &index) && index < HDR_BUCKETS && read_u64(stream, &histogram->counts[index]);
+    }
+    return success;
+}
+
+
+/**
+ * @brief Serialize the histograms of every level.
+ */
+static int write_histograms(FILE *stream) {
+    int success = TRUE;
+    for (int level = 0; level < LEVELS && success; level ++) {
+        success = write_histogram(stream, &run_wait_histogram[level]) && write_histogram(stream, &io_wait_histogram[level]);
+    }
+    return success;
+}
+
+
+/**
+ * @brief Deserialize the histograms of every level.
+ */
+static int read_histograms(FILE *stream) {
+    int success = TRUE;
+    for (int level = 0; level < LEVELS && success; level ++) {
+        success = read_histogram(stream, &run_wait_histogram[level]) && read_histogram(stream, &io_wait_histogram[level]);
+    }
+    return success;
+}
+
+
+/**
+ * @brief Save the scheduler state
+ * Writes the clock, the null and running processes, the input position, the
+ * latency, sampling and trace state, and every scheduler queue in a binary snapshot file.
+ * The file is written next to its destination and renamed once complete,
+ * so an interrupted write never corrupts the previous checkpoint.
+ *
+ * @param path destination file.
+ * @returns TRUE on success.
+ */
+int save_checkpoint(const char *path) {
+    char temporary[1024];
+    FILE *stream;
+    int success;
+
+    snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)getpid());
+    stream = fopen(temporary, "wb");
+    if (stream == NULL) { return FALSE; }
+
+    success = write_u32(stream, CHECKPOINT_MAGIC)
+        && write_u32(stream, CHECKPOINT_VERSION)
+        && write_u32(stream, mlqfs_clock)
+        && write_u32(stream, quantum_threshold[0])
+        && write_u32(stream, quantum_threshold[1])
+        && write_u32(stream, quantum_threshold[2])
+        && write_u64(stream, input_offset)
+        && write_process_counters(stream, &null)
+        && write_process_counters(stream, &running)
+        && write_summary(stream, &response_summary)
+        && write_summary(stream, &waiting_summary)
+        && write_summary(stream, &turnaround_summary)
+        && write_histograms(stream)
+        && write_u32(stream, sampled_null_ticks)
+        && write_u32(stream, trace.slice_pid)
+        && write_u32(stream, trace.slice_level)
+        && write_u32(stream, trace.slice_start)
+        && write_queue(stream, &arrival_queue, write_process)
+        && write_queue(stream, &ready_queue, write_process)
+        && write_queue(stream, &io_queue, write_process)
+        && write_queue(stream, &logs, write_process);
+
+    success = (fclose(stream) == 0) && success;
+    success = success && rename(temporary, path) == 0;
+    if (!success) { remove(temporary); }
+    return success;
+}
+
+
+/**
+ * @brief Recount the length of each level, after the queues were restored.
+ */
+static void count_levels() {
+    Context context;
+    Process *process;
+
+    local_init_context(&ready_queue, &context);
+    while (!local_end_of_queue(&context)) {
+        ready_length[local_current_priority(&context)] ++;
+        local_next_element(&context);
+    }
+
+    local_init_context(&io_queue, &context);
+    while (!local_end_of_queue(&context)) {
+        process = local_pointer_to_current(&context);
+        io_length[process->priority_cache] ++;
+        local_next_element(&context);
+    }
+}
+
+
+/**
+ * @brief Restore the scheduler state
+ * Loads a snapshot written by save_checkpoint() into freshly initialised
+ * scheduler queues.
+ *
+ * @param path checkpoint file.
+ * @returns TRUE on success.
+ */
+int load_checkpoint(const char *path) {
+    unsigned int magic, version;
+    int success;
+    FILE *stream = fopen(path, "rb");
+    if (stream == NULL) { return FALSE; }
+
+    success = read_u32(stream, &magic) && magic == CHECKPOINT_MAGIC
+        && read_u32(stream, &version) && version == CHECKPOINT_VERSION
+        && read_u32(stream, &mlqfs_clock)
+        && read_u32(stream, (unsigned int *)&quantum_threshold[0])
+        && read_u32(stream, (unsigned int *)&quantum_threshold[1])
+        && read_u32(stream, (unsigned int *)&quantum_threshold[2])
+        && read_u64(stream, &input_offset)
+        && read_process_counters(stream, &null)
+        && read_process_counters(stream, &running)
+        && read_summary(stream, &response_summary)
+        && read_summary(stream, &waiting_summary)
+        && read_summary(stream, &turnaround_summary)
+        && read_histograms(stream)
+        && read_u32(stream, &sampled_null_ticks)
+        && read_u32(stream, (unsigned int *)&trace.slice_pid)
+        && read_u32(stream, (unsigned int *)&trace.slice_level)
+        && read_u32(stream, &trace.slice_start)
+        && read_queue(stream, &arrival_queue, read_process)
+        && read_queue(stream, &ready_queue, read_process)
+        && read_queue(stream, &io_queue, read_process)
+        && read_queue(stream, &logs, read_process);
+
+    fclose(stream);
+    if (success) { count_levels(); }
+    return success;
+}
+
+
+/**
+ * @brief Wait for the checkpoint writer
+ * Reaps the last checkpoint writer process, reporting its failure.
+ *
+ * @param block if FALSE, returns right away when the writer is still running.
+ */
+static void wait_checkpoint_writer(int block) {
+    int status;
+    if (checkpoint_writer <= 0) { return; }
+    if (waitpid(checkpoint_writer, &status, block ? 0 : WNOHANG) == 0) { return; }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "mlqfs: failed to write checkpoint %s.\n", checkpoint_path);
+    }
+    checkpoint_writer = 0;
+}
+
+
+/**
+ * @brief Snapshot the scheduler in the background
+ * Forks a writer process which serializes its copy-on-write view of the
+ * scheduler state while the simulation carries on.
+ * Only one writer runs at a time so snapshots land in order.
+ * Falls back to a synchronous write if fork fails.
+ */
+void checkpoint_scheduler() {
+    // flush pending output so the writer doesn't inherit a buffer to print twice.
+    fflush(output);
+    wait_checkpoint_writer(TRUE);
+
+    checkpoint_writer = fork();
+    if (checkpoint_writer == 0) {
+        _exit(save_checkpoint(checkpoint_path) ? 0 : 1);
+    }
+    if (checkpoint_writer < 0) {
+        checkpoint_writer = 0;
+        if (!save_checkpoint(checkpoint_path)) {
+            fprintf(stderr, "mlqfs: failed to write checkpoint %s.\n", checkpoint_path);
+        }
+    }
+}
+
+
+/**
+ * @brief Apply a what-if parameter delta
+ * Parses a branch description made of ';' separated directives and applies
+ * it to the restored scheduler state:
+ * - "quantum Q1 Q2 Q3" replaces the quantum of each level.
+ * - "inject ARRIVAL PID CPU IO REPEATS" adds a process to the arrival queue.
+ *   The pid must not belong to a process already in the scheduler.
+ *
+ * @param description branch line, modified in place by the tokenizer.
+ * @returns TRUE if every directive was understood and applicable.
+ */
+int apply_branch_delta(char *description) {
+    char *directive, *save = NULL;
+
+    for (directive = strtok_r(description, ";", &save); directive != NULL; directive = strtok_r(NULL, ";", &save)) {
+        char name[16] = "";
+        int quanta[LEVELS];
+        unsigned int arrival;
+        int pid;
+        Behaviour behaviour;
+        Process process;
+
+        if (sscanf(directive, "%15s", name) != 1) { continue; }
+
+        if (strcmp(name, "quantum") == 0) {
+            if (sscanf(directive, "%*s %d %d %d", &quanta[0], &quanta[1], &quanta[2]) != 3
+                || quanta[0] <= 0 || quanta[1] <= 0 || quanta[2] <= 0) {
+                return FALSE;
+            }
+            memcpy(quantum_threshold, quanta, sizeof(quantum_threshold));
+        }
+
+        else if (strcmp(name, "inject") == 0) {
+            if (sscanf(directive, "%*s %u %d %u %u %u", &arrival, &pid, &behaviour.cpu_time, &behaviour.io_time, &behaviour.repeats) != 5) {
+                return FALSE;
+            }
+            init_process(&process);
+            process.pid = pid;
+            process.arrival_time = arrival;
+            add_to_queue(&process.behaviours, &behaviour, 1);
+            // a pid already arrived, waiting, running, in io or finished is rejected.
+            if (element_in_queue(&arrival_queue, &process) || element_in_queue(&ready_queue, &process)
+                || element_in_queue(&io_queue, &process) || element_in_queue(&logs, &process)) {
+                destroy_queue(&process.behaviours);
+                return FALSE;
+            }
+            add_to_queue(&arrival_queue, &process, process.arrival_time);
+        }
+
+        else {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+/**
+ * @brief Run one what-if branch
+ * Called in a forked child owning a copy-on-write view of the restored state.
+ * Applies the branch delta, then simulates to completion into its own output.
+ * Never returns.
+ */
+static void run_branch(char *description, const char *output_path) {
+    char label[1024], branch_histogram_path[1032], branch_series_path[1040], branch_trace_path[1040];
+    snprintf(label, sizeof(label), "%s", description);
+
+    // branches dump their histograms next to their output.
+    if (histogram_path != NULL) {
+        snprintf(branch_histogram_path, sizeof(branch_histogram_path), "%s.hdr", output_path);
+        histogram_path = branch_histogram_path;
+    }
+    if (sample_interval > 0) {
+        snprintf(branch_series_path, sizeof(branch_series_path), "%s.series%s", output_path,
+                 strlen(series_path) >= 4 && strcmp(series_path + strlen(series_path) - 4, ".bin") == 0 ? ".bin" : ".csv");
+        series_path = branch_series_path;
+    }
+    if (trace_path != NULL) {
+        snprintf(branch_trace_path, sizeof(branch_trace_path), "%s.trace.json", output_path);
+        trace_path = branch_trace_path;
+    }
+
+    if (!apply_branch_delta(description)) {
+        fprintf(stderr, "mlqfs: invalid branch \"%s\".\n", label);
+        _exit(2);
+    }
+    output = fopen(output_path, "w");
+    if (output == NULL) {
+        perror(output_path);
+        _exit(1);
+    }
+
+    // branches never overwrite the snapshot they were forked from.
+    checkpoint_interval = 0;
+    run_scheduler();
+    print_report();
+    fclose(output);
+    exit(0);
+}
+
+
+/**
+ * @brief Explore what-if branches from the restored state
+ * Each line of the branches file is an alternative future, see apply_branch_delta().
+ * Every branch runs in its own forked scheduler, sharing the restored state
+ * copy-on-write instead of reloading it, with up to 'jobs' branches in parallel.
+ * Branch n writes its output to "[output_base].n".
+ *
+ * @returns the number of branches which failed.
+ */
+int explore_branches(const char *branches_path, const char *output_base, int jobs) {
+    char line[1024];
+    int branch = 0, active = 0, failures = 0, status;
+    FILE *branches = fopen(branches_path, "r");
+    if (branches == NULL) {
+        perror(branches_path);
+        return 1;
+    }
+
+    // the children inherit the stdio buffers.
+    fflush(NULL);
+
+    while (fgets(line, sizeof(line), branches) != NULL) {
+        char output_path[1024];
+        pid_t child;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0' || line[strspn(line, " \t")] == '#') { continue; }
+
+        branch ++;
+        snprintf(output_path, sizeof(output_path), "%s.%d", output_base, branch);
+
+        if (active >= jobs) {
+            wait(&status);
+            active --;
+            failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+
+        child = fork();
+        if (child == 0) {
+            fclose(branches);
+            run_branch(line, output_path);
+        }
+        if (child < 0) {
+            perror("fork");
+            failures ++;
+            continue;
+        }
+        active ++;
+    }
+    fclose(branches);
+
+    while (active > 0) {
+        wait(&status);
+        active --;
+        failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return failures;
+}
+
+
+/**
+ * @brief Write the occupancy sample of the interval ending at 'time'.
+ */
+static void emit_sample(unsigned int time, unsigned int ticks) {
+    Sample sample;
+
+    sample.time = time;
+    sample.ticks = ticks;
+    memcpy(sample.ready, ready_length, sizeof(sample.ready));
+    memcpy(sample.io, io_length, sizeof(sample.io));
+    sample.running = running.pid;
+    sample.null_ticks = sampled_null_ticks;
+    sampled_null_ticks = 0;
+
+    if (!write_sample(&series, &sample)) {
+        perror("mlqfs: time series");
+        close_series(&series);
+        sample_interval = 0;
+    }
+}
+
+
+/**
+ * @brief Account for ticks in the occupancy time series
+ * Covers 'ticks' ticks from the current clock, with the current queue
+ * lengths, emitting a sample at every multiple of sample_interval crossed.
+ *
+ * @param idle TRUE if the null process ran these ticks.
+ */
+static void sample_occupancy(unsigned int ticks, int idle) {
+    unsigned int position = mlqfs_clock;
+
+    while (ticks > 0 && sample_interval > 0) {
+        unsigned int span = sample_interval - position % sample_interval;
+        if (span > ticks) { span = ticks; }
+        if (idle) { sampled_null_ticks += span; }
+        position += span;
+        ticks -= span;
+        if (position % sample_interval == 0) { emit_sample(position, sample_interval); }
+    }
+}
+
+
+/**
+ * @brief Skip idle ticks
+ * While no process is ready, the ticks until the next arrival or I/O
+ * completion only run the null process: they are accounted at once and the
+ * clock jumps to the next event. Stops at the next checkpoint time.
+ */
+static void fast_forward() {
+    unsigned int target = UINT_MAX, skipped;
+
+    if (queue_length(&ready_queue) > 0) { return; }
+    if (queue_length(&arrival_queue) > 0) { target = current_priority(&arrival_queue); }
+    if (queue_length(&io_queue) > 0 && (unsigned int)current_priority(&io_queue) < target) { target = current_priority(&io_queue); }
+    if (target == UINT_MAX) { return; }
+    if (checkpoint_interval > 0) {
+        unsigned int next_checkpoint = (mlqfs_clock + checkpoint_interval - 1) / checkpoint_interval * checkpoint_interval;
+        if (next_checkpoint < target) { target = next_checkpoint; }
+    }
+    if (target <= mlqfs_clock) { return; }
+
+    skipped = target - mlqfs_clock;
+    COUNT(fast_forwarded_ticks, skipped);
+    null.total_cpu_usage += skipped;
+    sample_occupancy(skipped, TRUE);
+    mlqfs_clock = target;
+}
+
+
+/**
+ * @brief Simulate until every process terminates, then shut the scheduler down.
+ * Outside of live and real modes, idle stretches are skipped in one step.
+ * Writes the occupancy time series and the trace if they are enabled.
+ */
+void run_scheduler() {
+    if (sample_interval > 0 && !open_series(&series, series_path)) {
+        perror(series_path);
+        sample_interval = 0;
+    }
+    if (trace_path != NULL && !open_trace(&trace, trace_path)) {
+        perror(trace_path);
+    }
+
     while (scheduler_is_active()) {
+        if (checkpoint_interval > 0 && mlqfs_clock > 0 && mlqfs_clock % checkpoint_interval == 0) {
+            checkpoint_scheduler();
+        }
+        if (live) {
+            wait_for_tick();
+            accept_live_processes();
+        }
         check_top_process_quanta();
         queue_new_processes();
         schedule_processes();
         run_top_process();
+        sample_occupancy(1, queue_length(&ready_queue) == 0);
         mlqfs_clock ++;
+        COUNT(ticks, 1);
+        if (!live && !real) { fast_forward(); }
     }
     mlqfs_clock --;
+
+    // the last interval is usually cut short.
+    if (sample_interval > 0) {
+        if ((mlqfs_clock + 1) % sample_interval != 0) { emit_sample(mlqfs_clock + 1, (mlqfs_clock + 1) % sample_interval); }
+        close_series(&series);
+    }
+    close_trace(&trace, mlqfs_clock + 1);
     shutdown_scheduler();
-    // --- END SCHEDULER ---
+    wait_checkpoint_writer(TRUE);
+}
+
+
+/**
+ * @brief Run the scheduler on a live feed
+ * Process descriptions are read from a FIFO (or file) or from a Unix socket
+ * while the simulation runs, and events are written as they happen.
+ *
+ * @param path feed location.
+ * @param is_socket TRUE to listen on a Unix socket at 'path'.
+ * @param restore_path checkpoint to resume from, or NULL.
+ * @param output_path output file, or NULL for stdout.
+ * @returns the process exit status.
+ */
+int run_live(const char *path, int is_socket, const char *restore_path, const char *output_path) {
+    if (restore_path != NULL && !load_checkpoint(restore_path)) {
+        fprintf(stderr, "mlqfs: cannot restore checkpoint %s.\n", restore_path);
+        return 1;
+    }
+
+    if (!(is_socket ? open_socket_feed(&feed, path) : open_file_feed(&feed, path))) {
+        perror(path);
+        return 1;
+    }
+    live = TRUE;
+
+    // a replayed feed resumes where the snapshot left it.
+    if (restore_path != NULL && !seek_feed(&feed, input_offset)) {
+        fprintf(stderr, "mlqfs: feed %s is not seekable, resuming with its current data.\n", path);
+    }
+
+    output = output_path != NULL ? fopen(output_path, "w") : stdout;
+    if (output == NULL) {
+        perror(output_path);
+        return 1;
+    }
+    setvbuf(output, NULL, _IOLBF, 0);
+
+    run_scheduler();
+    print_report();
+
+    close_feed(&feed);
+    if (output_path != NULL) { fclose(output); }
+    return 0;
+}
+
+
+/**
+ * @brief Print how fast the batch run went, on stderr.
+ */
+static void print_perf_summary(long long load_ns, long long simulation_ns) {
+    struct rusage usage;
+    unsigned int ticks = mlqfs_clock + 1;
+    double seconds = simulation_ns > 0 ? simulation_ns / 1e9 : 1e-9;
+
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "perf: load_ms=%.3f simulation_ms=%.3f ticks=%u ticks_per_sec=%.0f events=%llu events_per_sec=%.0f peak_rss_kb=%ld\n",
+            load_ns / 1e6, simulation_ns / 1e6, ticks, ticks / seconds, event_count, event_count / seconds, usage.ru_maxrss);
+}
+
+
+#if defined(MLQFS_COUNTERS) || defined(PRIOQUE_COUNTERS)
+/**
+ * @brief Print the compiled in counters on stderr, registered with atexit().
+ * What-if branches print their own, tagged with their pid.
+ */
+static void print_counters(void) {
+    fprintf(stderr, "counters[%d]:", (int)getpid());
+#if defined(MLQFS_COUNTERS)
+    fprintf(stderr, " ticks=%llu fast_forwarded_ticks=%llu schedule_iterations=%llu schedule_iterations_per_tick=%.3f schedule_iterations_max=%llu",
+            counters.ticks, counters.fast_forwarded_ticks, counters.schedule_iterations,
+            counters.ticks > 0 ? (double)counters.schedule_iterations / counters.ticks : 0.0, counters.schedule_iterations_max);
+#endif
+#if defined(PRIOQUE_COUNTERS)
+    fprintf(stderr, " add_walked=%llu find_walked=%llu mallocs=%llu frees=%llu memcpy_bytes=%llu lock_acquisitions=%llu",
+            prioque_counters.add_walked, prioque_counters.find_walked, prioque_counters.mallocs,
+            prioque_counters.frees, prioque_counters.memcpy_bytes, prioque_counters.lock_acquisitions);
+#endif
+    fprintf(stderr, "\n");
+}
+#endif
+
+
+/**
+ * @brief Start counting the hardware events of a phase, if enabled.
+ */
+static void start_phase() {
+    if (hardware_summary) { start_hardware_counters(&hardware_counters); }
+}
+
+
+static void stop_phase(int phase) {
+    if (hardware_summary) { stop_hardware_counters(&hardware_counters, &hardware_readings[phase]); }
+}
+
+
+/**
+ * @brief Print the hardware events of every phase of the batch run, on stderr.
+ */
+static void print_hardware_summary() {
+    for (int phase = 0; phase < PHASES; phase ++) {
+        print_hardware_reading(stderr, phase_names[phase], &hardware_readings[phase]);
+    }
+    close_hardware_counters(&hardware_counters);
+}
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-c interval] [-C checkpoint] [-r checkpoint [-w branches] [-j jobs]] [inputfile [outputfile]]\n", name);
+    fprintf(stderr, "       %s [-l fifo | -u socket] [-t ticks_per_ms] [-c interval] [-C checkpoint] [-r checkpoint] [outputfile]\n", name);
+    fprintf(stderr, "       %s -x tick_us [-X burner_command] [-l fifo | -u socket | inputfile] [outputfile]\n", name);
+    fprintf(stderr, "       in every mode: [-H histograms] [-s sample_interval] [-S series] [-T trace] [-p] [-P]\n");
+}
+
+
+int main(int argc, const char * argv[]) {
+    const char *restore_path = NULL, *branches_path = NULL, *feed_path = NULL;
+    int feed_is_socket = FALSE;
+    FILE *input = stdin;
+    long long started, load_ns, simulation_ns;
+    int option, jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    while ((option = getopt(argc, (char * const *)argv, "c:C:r:w:j:l:u:t:x:X:H:s:S:T:pP")) != -1) {
+        switch (option) {
+            case 'c': checkpoint_interval = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'C': checkpoint_path = optarg; break;
+            case 'r': restore_path = optarg; break;
+            case 'w': branches_path = optarg; break;
+            case 'j': jobs = atoi(optarg); break;
+            case 'l': feed_path = optarg; feed_is_socket = FALSE; break;
+            case 'u': feed_path = optarg; feed_is_socket = TRUE; break;
+            case 't': ticks_per_ms = atof(optarg); break;
+            case 'x': real = TRUE; tick_ns = (long long)(atof(optarg) * 1000); break;
+            case 'X': burner_command = optarg; break;
+            case 'H': histogram_path = optarg; break;
+            case 's': sample_interval = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'S': series_path = optarg; break;
+            case 'T': trace_path = optarg; break;
+            case 'p': perf_summary = TRUE; break;
+            case 'P': hardware_summary = TRUE; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if ((branches_path != NULL && (restore_path == NULL || feed_path != NULL)) || jobs < 1 || ticks_per_ms < 0
+        || (real && (tick_ns <= 0 || restore_path != NULL || checkpoint_interval > 0))) {
+        usage(argv[0]);
+        return 1;
+    }
+    argc -= optind;
+    argv += optind;
+
+#if defined(MLQFS_COUNTERS) || defined(PRIOQUE_COUNTERS)
+    atexit(print_counters);
+#endif
+    init_scheduler();
+
+    if (feed_path != NULL) {
+        return run_live(feed_path, feed_is_socket, restore_path, argc >= 1 ? argv[0] : NULL);
+    }
+
+    // the run goes on without them if perf events are not permitted.
+    if (hardware_summary && open_hardware_counters(&hardware_counters) == 0) {
+        fprintf(stderr, "hwperf: hardware counters unavailable: %s\n", strerror(hardware_counters.error));
+        hardware_summary = FALSE;
+    }
+
+    started = wall_time();
+    start_phase();
+    if (argc >= 1) {
+        input = fopen(argv[0], "r");
+        if (input == NULL) {
+            perror(argv[0]);
+            return 1;
+        }
+    }
+
+    if (restore_path != NULL) {
+        if (!load_checkpoint(restore_path)) {
+            fprintf(stderr, "mlqfs: cannot restore checkpoint %s.\n", restore_path);
+            return 1;
+        }
+        // resume reading the input where the snapshot left it, if one is given.
+        if (argc >= 1 && fseek(input, (long)input_offset, SEEK_SET) == 0) {
+            load_process_descriptions(input);
+        }
+    } else {
+        load_process_descriptions(input);
+    }
+    if (argc >= 1) { fclose(input); }
+    load_ns = wall_time() - started;
+    stop_phase(LOAD_PHASE);
+
+    // what-if branches each write their own output.
+    if (branches_path != NULL) {
+        return explore_branches(branches_path, argc >= 2 ? argv[1] : "whatif", jobs) == 0 ? 0 : 1;
+    }
+
+    if (argc >= 2) {
+        output = fopen(argv[1], "w");
+    } else {
+        output = stdout;
+    }
 
+    started = wall_time();
+    start_phase();
+    run_scheduler();
+    simulation_ns = wall_time() - started;
+    stop_phase(SIMULATION_PHASE);
+    start_phase();
     print_report();
+    stop_phase(REPORT_PHASE);
 
-    if (argc >= 3) { fclose(output); }
+    if (argc >= 2) { fclose(output); }
+    if (perf_summary) { print_perf_summary(load_ns, simulation_ns); }
+    if (hardware_summary) { print_hardware_summary(); }
     return 0;
 }
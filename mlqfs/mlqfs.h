@@ -10,6 +10,7 @@
 #define mlqfs_h
 
 #include <stdio.h>
+#include <sys/types.h>
 #include "prioque.h"
 
 typedef struct Process {
@@ -23,6 +24,18 @@ typedef struct Process {
     unsigned int promotion;
     unsigned int demotion;
     unsigned int total_cpu_usage;
+    pid_t burner;           // child process backing it in real mode.
+    int burner_exited;      // its burner exited and was reaped, the rest is simulated.
+    long long cpu_time;     // CPU nanoseconds measured on the burner in real mode.
+    long long created_at;   // wall clock nanoseconds of its creation and termination in real mode.
+    long long finished_at;
+    int started;                    // had its first RUN.
+    unsigned int blocked_time;      // clock when it last blocked for I/O.
+    unsigned int io_ticks;          // ticks spent blocked for I/O.
+    unsigned int response_time;     // ticks from arrival to the first RUN.
+    unsigned int waiting_time;      // ticks ready but not running, set on termination.
+    unsigned int turnaround_time;   // ticks from arrival to termination, set on termination.
+    unsigned int ready_since;       // clock since which it has been ready without running.
 } Process;
 
 typedef struct Behaviour {
@@ -55,6 +68,7 @@ void init_scheduler(void);
  * free the memory for all the scheduler state queues.
  * saves the null process logs.
  * logs the shutdown time.
+ * dumps the latency histograms if requested.
  */
 void shutdown_scheduler(void);
 
@@ -62,10 +76,21 @@ void shutdown_scheduler(void);
  * @brief Check the activity of the MLQFScheduler
  * the scheduler is considered active as long as there
  * is an active process running, waiting io, or waiting to start.
+ * In live mode, it also stays active until the producer closes the feed.
  * @return boolean
  */
 int scheduler_is_active(void);
 
+/**
+ * @brief Load live process descriptions
+ * Parses the records buffered by the live feed, with the same format as
+ * load_process_descriptions(). Consecutive records of one PID describe one
+ * process, which is pushed in the arrival queue once a record of another
+ * PID follows, the feed ends, or its arrival time is reached: descriptions
+ * must be complete before the process arrives.
+ */
+void accept_live_processes(void);
+
 /**
  * @brief Queue processes to CPU
  * At current clock time, pull all the processes from the arrival and
@@ -88,8 +113,84 @@ void schedule_processes(void);
  */
 void run_top_process(void);
 
+/**
+ * @brief Save the scheduler state
+ * Writes the clock, the null and running processes, the input position, the
+ * latency, sampling and trace state, and every scheduler queue in a binary snapshot file.
+ * The file is written next to its destination and renamed once complete,
+ * so an interrupted write never corrupts the previous checkpoint.
+ *
+ * @param path destination file.
+ * @returns TRUE on success.
+ */
+int save_checkpoint(const char *path);
+
+/**
+ * @brief Restore the scheduler state
+ * Loads a snapshot written by save_checkpoint() into freshly initialised
+ * scheduler queues.
+ *
+ * @param path checkpoint file.
+ * @returns TRUE on success.
+ */
+int load_checkpoint(const char *path);
+
+/**
+ * @brief Snapshot the scheduler in the background
+ * Forks a writer process which serializes its copy-on-write view of the
+ * scheduler state while the simulation carries on.
+ * Only one writer runs at a time so snapshots land in order.
+ * Falls back to a synchronous write if fork fails.
+ */
+void checkpoint_scheduler(void);
+
+/**
+ * @brief Simulate until every process terminates, then shut the scheduler down.
+ * Outside of live and real modes, idle stretches are skipped in one step.
+ * Writes the occupancy time series and the trace if they are enabled.
+ */
+void run_scheduler(void);
+
+/**
+ * @brief Apply a what-if parameter delta
+ * Parses a branch description made of ';' separated directives and applies
+ * it to the restored scheduler state:
+ * - "quantum Q1 Q2 Q3" replaces the quantum of each level.
+ * - "inject ARRIVAL PID CPU IO REPEATS" adds a process to the arrival queue.
+ *
+ * @param description branch line, modified in place by the tokenizer.
+ * @returns TRUE if every directive was understood.
+ */
+int apply_branch_delta(char *description);
+
+/**
+ * @brief Explore what-if branches from the restored state
+ * Each line of the branches file is an alternative future, see apply_branch_delta().
+ * Every branch runs in its own forked scheduler, sharing the restored state
+ * copy-on-write instead of reloading it, with up to 'jobs' branches in parallel.
+ * Branch n writes its output to "[output_base].n".
+ *
+ * @returns the number of branches which failed.
+ */
+int explore_branches(const char *branches_path, const char *output_base, int jobs);
+
+/**
+ * @brief Run the scheduler on a live feed
+ * Process descriptions are read from a FIFO (or file) or from a Unix socket
+ * while the simulation runs, and events are written as they happen.
+ *
+ * @param path feed location.
+ * @param is_socket TRUE to listen on a Unix socket at 'path'.
+ * @param restore_path checkpoint to resume from, or NULL.
+ * @param output_path output file, or NULL for stdout.
+ * @returns the process exit status.
+ */
+int run_live(const char *path, int is_socket, const char *restore_path, const char *output_path);
+
 /**
  * @brief prints formated output of total cpu usage of every processes, NULL inluded.
+ * Followed by the response, waiting and turnaround times of each process,
+ * and their mean, median, 99th percentile and maximum over all processes.
  */
 void print_report(void);
 
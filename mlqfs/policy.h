@@ -0,0 +1,23 @@
+/**
+ *  policy.h
+ *  mlqfs
+ *
+ *  Multilevel feedback policy shared by the simulator and the runtimes.
+ *  Levels are numbered from MAX_PRIORITY (highest) to MIN_PRIORITY.
+ */
+
+#ifndef policy_h
+#define policy_h
+
+#define MAX_PRIORITY 0
+#define MIN_PRIORITY 2
+#define LEVELS (MIN_PRIORITY + 1)
+
+// Quantum of each level, in scheduler ticks.
+#define DEFAULT_QUANTUM_THRESHOLD { 10, 30, 100 }
+
+// Consecutive exhausted quanta before a demotion, and consecutive I/O bursts before a promotion.
+static const int DEMOTION_THRESHOLD[LEVELS] = { 1, 2, 'X' };
+static const int PROMOTION_THRESHOLD[LEVELS] = { 'X', 2, 1 };
+
+#endif /* policy_h */
@@ -0,0 +1,333 @@
+/**
+ *  pool.c
+ *  mlqfs
+ *
+ *  Thread pool runtime scheduled with the multilevel feedback policy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pool.h"
+
+static const int QUANTUM_THRESHOLD[LEVELS] = DEFAULT_QUANTUM_THRESHOLD;
+
+// Worker running on the current thread, NULL outside of the pool.
+static __thread Worker *current_worker = NULL;
+
+static void stop_workers(Pool *pool, int started);
+static void free_pool(Pool *pool);
+
+
+static long long thread_cpu_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+/**
+ * @brief Queue a task at the rear of its level on a worker, and wake an idle worker.
+ */
+static void push_task(Worker *worker, Task *task) {
+    Pool *pool = worker->pool;
+
+    // counted before it can be taken, so that 'queued' never goes negative.
+    pthread_mutex_lock(&pool->lock);
+    pool->queued ++;
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_lock(&worker->lock);
+    add_to_queue(&worker->ready, &task, task->level);
+    pthread_mutex_unlock(&worker->lock);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/**
+ * @brief Remove the front task of a worker.
+ * @returns the task, or NULL if the worker has none.
+ */
+static Task *pop_task(Worker *worker) {
+    Task *task = NULL;
+    pthread_mutex_lock(&worker->lock);
+    if (queue_length(&worker->ready) > 0) {
+        remove_from_front(&worker->ready, &task);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return task;
+}
+
+
+/**
+ * @brief Wait for the next task of a worker
+ * Takes the front task of the worker queue, or steals the front task of
+ * the next busy worker. Sleeps while every queue is empty.
+ * @returns the task, or NULL when the pool shuts down.
+ */
+static Task *wait_task(Worker *worker) {
+    Pool *pool = worker->pool;
+    Task *task;
+
+    for (;;) {
+        task = pop_task(worker);
+        for (int i = 1; task == NULL && i < pool->size; i ++) {
+            task = pop_task(&pool->workers[(worker->index + i) % pool->size]);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (task != NULL) {
+            pool->queued --;
+            pthread_mutex_unlock(&pool->lock);
+            return task;
+        }
+        while (pool->queued == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+/**
+ * @brief Check if a task of a higher level than 'level' waits on the worker.
+ */
+static int preempted(Worker *worker, int level) {
+    int higher;
+    pthread_mutex_lock(&worker->lock);
+    higher = queue_length(&worker->ready) > 0 && current_priority(&worker->ready) < level;
+    pthread_mutex_unlock(&worker->lock);
+    return higher;
+}
+
+
+/**
+ * @brief Update a task which blocked on I/O
+ * Resets its quantum and increments its promotion counter. The task is
+ * promoted when the counter reaches the level promotion threshold.
+ */
+static void block_task(Task *task) {
+    task->promotion ++;
+    task->demotion = 0;
+    task->quanta = 0;
+
+    if (task->promotion >= PROMOTION_THRESHOLD[task->level]) {
+        task->promotion = 0;
+        if (task->level != MAX_PRIORITY) { task->level --; }
+    }
+}
+
+
+/**
+ * @brief Update a task which exhausted its quantum
+ * Increments its demotion counter. The task is demoted when the counter
+ * reaches the level demotion threshold.
+ */
+static void halt_task(Task *task) {
+    task->demotion ++;
+    task->promotion = 0;
+    task->quanta = 0;
+
+    if (task->demotion >= DEMOTION_THRESHOLD[task->level]) {
+        task->demotion = 0;
+        if (task->level != MIN_PRIORITY) { task->level ++; }
+    }
+}
+
+
+/**
+ * @brief Release a completed task, and signal wait_pool() after the last one.
+ */
+static void complete_task(Pool *pool, Task *task) {
+    free(task);
+    pthread_mutex_lock(&pool->lock);
+    pool->pending --;
+    if (pool->pending == 0) {
+        pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/**
+ * @brief Worker thread
+ * Runs the top task slice after slice while it yields within its quantum
+ * and no higher level task is waiting, then queues it back according to
+ * how its CPU burst ended.
+ */
+static void *run_worker(void *argument) {
+    Worker *worker = argument;
+    Pool *pool = worker->pool;
+    Task *task;
+
+    current_worker = worker;
+
+    while ((task = wait_task(worker)) != NULL) {
+        TaskStatus status;
+
+        do {
+            long long start = thread_cpu_time();
+            status = task->function(task->argument);
+            task->quanta += thread_cpu_time() - start;
+        } while (status == TASK_YIELD && pool->policy == POOL_MLQFS
+                 && task->quanta < pool->quantum[task->level] && !preempted(worker, task->level));
+
+        if (status == TASK_DONE) {
+            complete_task(pool, task);
+            continue;
+        }
+
+        if (pool->policy == POOL_MLQFS) {
+            if (status == TASK_IO) {
+                block_task(task);
+            } else if (task->quanta >= pool->quantum[task->level]) {
+                halt_task(task);
+            }
+        }
+        push_task(worker, task);
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Create a pool and start its workers
+ * @param workers number of worker threads.
+ * @param policy scheduling policy.
+ * @param tick_ns CPU nanoseconds of one tick: the level quanta are
+ *        DEFAULT_QUANTUM_THRESHOLD ticks long.
+ * @returns the pool, or NULL if it could not be started.
+ */
+Pool *create_pool(int workers, PoolPolicy policy, long long tick_ns) {
+    Pool *pool = calloc(1, sizeof(Pool));
+    if (pool == NULL || workers < 1) {
+        free(pool);
+        return NULL;
+    }
+
+    pool->workers = calloc(workers, sizeof(Worker));
+    if (pool->workers == NULL) {
+        free(pool);
+        return NULL;
+    }
+    pool->size = workers;
+    pool->policy = policy;
+    for (int level = MAX_PRIORITY; level <= MIN_PRIORITY; level ++) {
+        pool->quantum[level] = QUANTUM_THRESHOLD[level] * tick_ns;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0; i < workers; i ++) {
+        Worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_mutex_init(&worker->lock, NULL);
+        init_queue(&worker->ready, sizeof(Task *), TRUE, NULL, FALSE);
+    }
+
+    for (int i = 0; i < workers; i ++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, run_worker, &pool->workers[i]) != 0) {
+            stop_workers(pool, i);
+            free_pool(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+
+/**
+ * @brief Submit a task at the highest priority
+ * From a task, the new task is queued on the current worker, otherwise the
+ * workers are used in turn.
+ */
+void submit_task(Pool *pool, TaskFunction function, void *argument) {
+    Worker *worker = current_worker;
+    Task *task = malloc(sizeof(Task));
+    if (task == NULL) {
+        fprintf(stderr, "Malloc failed in function submit_task()\n");
+        exit(1);
+    }
+
+    task->function = function;
+    task->argument = argument;
+    task->level = MAX_PRIORITY;
+    task->quanta = 0;
+    task->promotion = 0;
+    task->demotion = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->pending ++;
+    if (worker == NULL || worker->pool != pool) {
+        worker = &pool->workers[pool->next_worker ++ % pool->size];
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    push_task(worker, task);
+}
+
+
+/**
+ * @brief Wait until every submitted task has completed.
+ */
+void wait_pool(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+/**
+ * @brief Wake every worker with the shutdown flag and join the first 'started' ones.
+ */
+static void stop_workers(Pool *pool, int started) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = TRUE;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < started; i ++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+}
+
+
+/**
+ * @brief Free the queues, dropping the tasks left, and the pool.
+ */
+static void free_pool(Pool *pool) {
+    Task *task;
+
+    for (int i = 0; i < pool->size; i ++) {
+        while ((task = pop_task(&pool->workers[i])) != NULL) { free(task); }
+        destroy_queue(&pool->workers[i].ready);
+        pthread_mutex_destroy(&pool->workers[i].lock);
+    }
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+
+/**
+ * @brief Stop the workers and free the pool
+ * Tasks still queued are dropped without being run.
+ */
+void destroy_pool(Pool *pool) {
+    stop_workers(pool, pool->size);
+    free_pool(pool);
+}
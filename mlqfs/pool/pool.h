@@ -0,0 +1,97 @@
+/**
+ *  pool.h
+ *  mlqfs
+ *
+ *  Thread pool runtime scheduled with the multilevel feedback policy.
+ *
+ *  Tasks are cooperative: a task function runs one slice of work and
+ *  returns what it wants next. Every task starts at MAX_PRIORITY. The CPU
+ *  time of each slice is measured on the worker thread; a task which keeps
+ *  yielding past its level quantum is halted and eventually demoted, like
+ *  halt_process(), and a task which blocked on I/O during its slice is
+ *  eventually promoted, like send_process_to_io().
+ *
+ *  Each worker owns a multilevel ready queue, and steals the front task of
+ *  another worker when its own queue is empty.
+ */
+
+#ifndef pool_h
+#define pool_h
+
+#include <pthread.h>
+#include "prioque.h"
+#include "policy.h"
+
+typedef enum TaskStatus {
+    TASK_DONE,      // the task is complete and is released.
+    TASK_YIELD,     // the task wants more CPU time.
+    TASK_IO         // the task blocked on I/O during its slice, and wants to run again.
+} TaskStatus;
+
+typedef TaskStatus (*TaskFunction)(void *argument);
+
+typedef enum PoolPolicy {
+    POOL_MLQFS,     // multilevel feedback queues.
+    POOL_FIFO       // single level, tasks run in submission order. Used as a baseline.
+} PoolPolicy;
+
+typedef struct Task {
+    TaskFunction function;
+    void *argument;
+    int level;
+    long long quanta;           // CPU nanoseconds consumed in the current quantum.
+    int promotion;
+    int demotion;
+} Task;
+
+typedef struct Worker {
+    pthread_t thread;
+    pthread_mutex_t lock;       // makes the length check and removal of a steal atomic.
+    Queue ready;                // Task pointers, by level.
+    struct Pool *pool;
+    int index;
+} Worker;
+
+typedef struct Pool {
+    Worker *workers;
+    int size;
+    PoolPolicy policy;
+    long long quantum[LEVELS];  // level quanta in CPU nanoseconds.
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // signaled when a task is queued or at shutdown.
+    pthread_cond_t idle;        // signaled when the last task completes.
+    int queued;                 // tasks in the ready queues.
+    int pending;                // tasks submitted and not completed.
+    int shutdown;
+    unsigned int next_worker;   // round robin placement of external submissions.
+} Pool;
+
+/**
+ * @brief Create a pool and start its workers
+ * @param workers number of worker threads.
+ * @param policy scheduling policy.
+ * @param tick_ns CPU nanoseconds of one tick: the level quanta are
+ *        DEFAULT_QUANTUM_THRESHOLD ticks long.
+ * @returns the pool, or NULL if it could not be started.
+ */
+Pool *create_pool(int workers, PoolPolicy policy, long long tick_ns);
+
+/**
+ * @brief Submit a task at the highest priority
+ * From a task, the new task is queued on the current worker, otherwise the
+ * workers are used in turn.
+ */
+void submit_task(Pool *pool, TaskFunction function, void *argument);
+
+/**
+ * @brief Wait until every submitted task has completed.
+ */
+void wait_pool(Pool *pool);
+
+/**
+ * @brief Stop the workers and free the pool
+ * Tasks still queued are dropped without being run.
+ */
+void destroy_pool(Pool *pool);
+
+#endif /* pool_h */
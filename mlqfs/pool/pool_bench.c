@@ -0,0 +1,133 @@
+/**
+ *  pool_bench.c
+ *  mlqfs
+ *
+ *  Latency of short interactive tasks submitted while batch tasks keep every
+ *  worker busy, with the multilevel policy and with the FIFO baseline.
+ *
+ *  $ gcc -O2 -o pool_bench -I../prioque -I.. ../prioque/prioque.c pool.c pool_bench.c -lpthread
+ *  $ ./pool_bench [workers] [batch_tasks] [interactive_tasks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "pool.h"
+
+#define SLICE_NS 200000LL               // CPU work between two yields.
+#define BATCH_NS 100000000LL            // CPU work of a batch task.
+#define INTERACTIVE_NS 20000LL          // CPU work of an interactive burst.
+#define INTERACTIVE_IO_US 200           // I/O wait between the two interactive bursts.
+#define INTERACTIVE_PERIOD_US 1000      // delay between two interactive submissions.
+#define TICK_NS 100000LL                // quanta of 1, 3 and 10 ms.
+
+typedef struct BatchTask {
+    long long done;
+} BatchTask;
+
+typedef struct InteractiveTask {
+    long long submitted;
+    long long latency;
+    int bursts;
+} InteractiveTask;
+
+
+static long long wall_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+static void burn(long long nanoseconds) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    do {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec) < nanoseconds);
+}
+
+
+static TaskStatus batch(void *argument) {
+    BatchTask *task = argument;
+    burn(SLICE_NS);
+    task->done += SLICE_NS;
+    return task->done >= BATCH_NS ? TASK_DONE : TASK_YIELD;
+}
+
+
+static TaskStatus interactive(void *argument) {
+    InteractiveTask *task = argument;
+    burn(INTERACTIVE_NS);
+    if (++ task->bursts == 1) {
+        usleep(INTERACTIVE_IO_US);
+        return TASK_IO;
+    }
+    task->latency = wall_time() - task->submitted;
+    return TASK_DONE;
+}
+
+
+static int compare_latency(const void *lhs, const void *rhs) {
+    long long left = *(const long long *)lhs, right = *(const long long *)rhs;
+    return (left > right) - (left < right);
+}
+
+
+static void run(const char *name, PoolPolicy policy, int workers, int batches, int requests) {
+    BatchTask *batch_tasks = calloc(batches, sizeof(BatchTask));
+    InteractiveTask *interactive_tasks = calloc(requests, sizeof(InteractiveTask));
+    long long *latencies = calloc(requests, sizeof(long long));
+    long long start = wall_time(), total = 0;
+    Pool *pool = create_pool(workers, policy, TICK_NS);
+
+    if (pool == NULL || batch_tasks == NULL || interactive_tasks == NULL || latencies == NULL) {
+        fprintf(stderr, "pool_bench: cannot start the pool.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < batches; i ++) {
+        submit_task(pool, batch, &batch_tasks[i]);
+    }
+    for (int i = 0; i < requests; i ++) {
+        usleep(INTERACTIVE_PERIOD_US);
+        interactive_tasks[i].submitted = wall_time();
+        submit_task(pool, interactive, &interactive_tasks[i]);
+    }
+    wait_pool(pool);
+
+    for (int i = 0; i < requests; i ++) {
+        latencies[i] = interactive_tasks[i].latency;
+        total += latencies[i];
+    }
+    qsort(latencies, requests, sizeof(long long), compare_latency);
+
+    printf("%-6s interactive latency: mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us  (total %.2f s)\n",
+           name, total / 1e3 / requests, latencies[requests / 2] / 1e3,
+           latencies[(requests * 99) / 100] / 1e3, latencies[requests - 1] / 1e3,
+           (wall_time() - start) / 1e9);
+
+    destroy_pool(pool);
+    free(latencies);
+    free(interactive_tasks);
+    free(batch_tasks);
+}
+
+
+int main(int argc, const char *argv[]) {
+    int workers = argc >= 2 ? atoi(argv[1]) : 4;
+    int batches = argc >= 3 ? atoi(argv[2]) : 4 * workers;
+    int requests = argc >= 4 ? atoi(argv[3]) : 500;
+
+    if (workers < 1 || batches < 0 || requests < 1) {
+        fprintf(stderr, "usage: %s [workers] [batch_tasks] [interactive_tasks]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d workers, %d batch tasks of %lld ms, %d interactive tasks\n",
+           workers, batches, BATCH_NS / 1000000, requests);
+    run("mlqfs", POOL_MLQFS, workers, batches, requests);
+    run("fifo", POOL_FIFO, workers, batches, requests);
+    return 0;
+}
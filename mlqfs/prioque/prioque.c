@@ -10,14 +10,21 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
 #include "prioque.h"
 
-// global lock on entire package
-pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
-
 // for init purposes
 pthread_mutex_t initial_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+#if defined(PRIOQUE_COUNTERS)
+// operation counters, shared by all threads
+Prioque_counters prioque_counters;
+#define COUNT(counter, n) \
+  __atomic_fetch_add(&prioque_counters.counter, (n), __ATOMIC_RELAXED)
+#else
+#define COUNT(counter, n) ((void)0)
+#endif
+
 // function prototypes for internal functions
 void nolock_next_element(Queue * q);
 void nolock_rewind_queue(Queue * q);
@@ -27,6 +34,811 @@ void local_nolock_next_element(Context * ctx);
 void local_nolock_rewind_queue(Context * ctx);
 
 
+// locks 'q' for an operation which may modify it.
+static void lock_queue(Queue * q) {
+
+  COUNT(lock_acquisitions, 1);
+  if(q->shared_reads) {
+    pthread_rwlock_wrlock(&(q->rwlock));
+  }
+  else {
+    pthread_mutex_lock(&(q->lock));
+  }
+}
+
+
+// locks 'q' for an operation which only reads it.  Readers of a queue
+// with shared reads hold the lock together; otherwise this is the
+// same as lock_queue().
+static void lock_queue_shared(Queue * q) {
+
+  COUNT(lock_acquisitions, 1);
+  if(q->shared_reads) {
+    pthread_rwlock_rdlock(&(q->rwlock));
+  }
+  else {
+    pthread_mutex_lock(&(q->lock));
+  }
+}
+
+
+static void unlock_queue(Queue * q) {
+
+  if(q->shared_reads) {
+    pthread_rwlock_unlock(&(q->rwlock));
+  }
+  else {
+    pthread_mutex_unlock(&(q->lock));
+  }
+}
+
+
+// locks two queues for a two-queue operation with 'lock'.  To avoid
+// deadlock, the locks are always taken in the same order, lowest
+// address first: operations on disjoint queue pairs never wait for
+// each other.
+static void lock_pair(Queue * q1, Queue * q2, void (*lock) (Queue * q)) {
+
+  if(q1 == q2) {
+    lock(q1);
+  }
+  else if(q1 < q2) {
+    lock(q1);
+    lock(q2);
+  }
+  else {
+    lock(q2);
+    lock(q1);
+  }
+}
+
+
+static void lock_queues(Queue * q1, Queue * q2) {
+
+  lock_pair(q1, q2, lock_queue);
+}
+
+
+static void lock_queues_shared(Queue * q1, Queue * q2) {
+
+  lock_pair(q1, q2, lock_queue_shared);
+}
+
+
+static void unlock_queues(Queue * q1, Queue * q2) {
+
+  if(q1 != q2) {
+    unlock_queue(q2);
+  }
+  unlock_queue(q1);
+}
+
+
+// an element and its data are one allocation: the data follows the
+// node, aligned for any type, so a walk comparing elements reads
+// adjacent memory instead of following a second pointer.
+#define ELEMENT_HEADER_SIZE \
+  ((sizeof(struct _Queue_element) + 15) & ~(size_t) 15)
+
+// fetches the node after 'ptr' while the current one is examined.
+#if defined(__GNUC__)
+#define PREFETCH_NEXT(ptr) __builtin_prefetch((ptr)->next)
+#else
+#define PREFETCH_NEXT(ptr) ((void)0)
+#endif
+
+
+// allocates an element with room for 'elementsize' bytes of data, 0
+// if out of memory.
+static Queue_element alloc_element(int elementsize) {
+
+  Queue_element element;
+
+  element = (Queue_element) malloc(ELEMENT_HEADER_SIZE + elementsize);
+  if(element != 0) {
+    element->info = (char *)element + ELEMENT_HEADER_SIZE;
+    COUNT(mallocs, 1);
+  }
+  return element;
+}
+
+
+static void free_element(Queue_element element) {
+
+  free(element);
+  COUNT(frees, 1);
+}
+
+
+////////////////////////////
+// priority index
+////////////////////////////
+
+// the index of a queue, from index_queue(): the last element of every
+// priority in the queue, sorted by priority.  The element after which
+// add_to_queue() links a new one is then found by binary search.
+struct Index_entry
+{
+  int priority;
+  Queue_element last;
+};
+
+struct Priority_index
+{
+  struct Index_entry *entries;
+  int count;
+  int capacity;
+};
+
+
+// returns the number of index entries with a priority lower than or
+// equal to 'priority'.
+static int index_search(struct Priority_index *index, int priority) {
+
+  int low = 0, high = index->count;
+
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if(index->entries[middle].priority <= priority) {
+      low = middle + 1;
+    }
+    else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+
+// returns the last element of 'q' with a priority lower than or equal
+// to 'priority', 0 if there is none.
+static Queue_element index_find(Queue * q, int priority) {
+
+  int i = index_search(q->index, priority);
+
+  return i > 0 ? q->index->entries[i - 1].last : 0;
+}
+
+
+static void index_insert(struct Priority_index *index, int i, int priority,
+			 Queue_element last) {
+
+  if(index->count == index->capacity) {
+    int capacity = index->capacity > 0 ? 2 * index->capacity : 8;
+    struct Index_entry *entries =
+      realloc(index->entries, capacity * sizeof(struct Index_entry));
+    if(entries == 0) {
+      assert(!"Malloc failed in function add_to_queue()\n");
+      exit(1);
+    }
+    index->entries = entries;
+    index->capacity = capacity;
+  }
+  memmove(&index->entries[i + 1], &index->entries[i],
+	  (index->count - i) * sizeof(struct Index_entry));
+  index->entries[i].priority = priority;
+  index->entries[i].last = last;
+  index->count++;
+}
+
+
+// records 'element', just linked after the elements of lower or equal
+// priority, as the last one of its priority.
+static void index_linked(Queue * q, Queue_element element) {
+
+  int i;
+
+  if(q->index == 0) {
+    return;
+  }
+  i = index_search(q->index, element->priority);
+  if(i > 0 && q->index->entries[i - 1].priority == element->priority) {
+    q->index->entries[i - 1].last = element;
+  }
+  else {
+    index_insert(q->index, i, element->priority, element);
+  }
+}
+
+
+// forgets 'element', about to be unlinked from after 'previous' (0 at
+// the front).
+static void index_unlinked(Queue * q, Queue_element element,
+			   Queue_element previous) {
+
+  int i;
+
+  if(q->index == 0) {
+    return;
+  }
+  i = index_search(q->index, element->priority) - 1;
+  if(i >= 0 && q->index->entries[i].last == element) {
+    if(previous != 0 && previous->priority == element->priority) {
+      q->index->entries[i].last = previous;
+    }
+    else {
+      memmove(&q->index->entries[i], &q->index->entries[i + 1],
+	      (q->index->count - i - 1) * sizeof(struct Index_entry));
+      q->index->count--;
+    }
+  }
+}
+
+
+// rebuilds the index after the list of 'q' changed as a whole.
+static void index_rebuild(Queue * q) {
+
+  Queue_element ptr;
+
+  if(q->index == 0) {
+    return;
+  }
+  q->index->count = 0;
+  for (ptr = q->queue; ptr != 0; ptr = ptr->next) {
+    if(ptr->next == 0 || ptr->next->priority != ptr->priority) {
+      index_insert(q->index, q->index->count, ptr->priority, ptr);
+    }
+  }
+}
+
+
+
+////////////////////////////
+// tails of recent priorities
+////////////////////////////
+
+// q->tails remembers the last element of the priorities most recently
+// added to, in slot 'priority' modulo QUEUE_TAIL_SLOTS, so that adding
+// to the rear of a level links the new element right behind it.  A slot
+// is 0 or the last element of its own priority in the list.
+static Queue_element *tail_slot(Queue * q, int priority) {
+
+  return &q->tails[(unsigned)priority % QUEUE_TAIL_SLOTS];
+}
+
+
+// records 'element', just linked into the list of 'q'.
+static void element_linked(Queue * q, Queue_element element) {
+
+  if(!q->priority_is_tag_only) {
+    *tail_slot(q, element->priority) = element;
+  }
+  index_linked(q, element);
+}
+
+
+// forgets 'element', about to be unlinked from after 'previous' (0 at
+// the front).
+static void element_unlinked(Queue * q, Queue_element element,
+			     Queue_element previous) {
+
+  Queue_element *slot = tail_slot(q, element->priority);
+
+  if(*slot == element) {
+    *slot = previous != 0 && previous->priority == element->priority ?
+      previous : 0;
+  }
+  index_unlinked(q, element, previous);
+}
+
+
+// forgets the tails and rebuilds the index after the list of 'q'
+// changed as a whole.
+static void list_relinked(Queue * q) {
+
+  memset(q->tails, 0, sizeof(q->tails));
+  index_rebuild(q);
+}
+
+
+
+////////////////////////////
+// copy-on-write sharing of lists between queues
+////////////////////////////
+
+// a list of elements shared by queues after snapshot_queue().  Every
+// sharing queue holds a reference and reads a suffix of the list from
+// 'head': removing from its front only moves the queue past nodes.  A
+// queue about to change its elements first takes a private copy; the
+// last reference frees the shared nodes.
+struct Shared_list
+{
+  int references;
+  Queue_element head;
+};
+
+
+static void free_elements(Queue_element ptr, Queue_element end) {
+
+  Queue_element temp;
+
+  while (ptr != end) {
+    temp = ptr;
+    ptr = ptr->next;
+    free_element(temp);
+  }
+}
+
+
+static void release_list(struct Shared_list *shared) {
+
+  if(__atomic_fetch_sub(&shared->references, 1, __ATOMIC_ACQ_REL) == 1) {
+    free_elements(shared->head, 0);
+    free(shared);
+  }
+}
+
+
+// gives 'q' a list of its own before it changes an element or a link.
+// The global position, and the position of 'ctx' unless it is 0, move
+// to the copies of their elements.  Called with 'q' locked.
+static void nolock_own_list(Queue * q, Context * ctx) {
+
+  Queue_element temp, new_element, endq = 0, list = 0;
+
+  if(q->shared == 0) {
+    return;
+  }
+
+  if(__atomic_load_n(&q->shared->references, __ATOMIC_ACQUIRE) == 1) {
+    // the last queue on the list takes it over, minus the removed front
+    free_elements(q->shared->head, q->queue);
+    free(q->shared);
+    q->shared = 0;
+    return;
+  }
+
+  for (temp = q->queue; temp != 0; temp = temp->next) {
+    new_element = alloc_element(q->elementsize);
+    if(new_element == 0) {
+      assert(!"Malloc failed in function nolock_own_list()\n");
+      exit(1);
+    }
+    memcpy(new_element->info, temp->info, q->elementsize);
+    COUNT(memcpy_bytes, q->elementsize);
+    new_element->priority = temp->priority;
+    new_element->next = 0;
+
+    if(endq == 0) {
+      list = new_element;
+    }
+    else {
+      endq->next = new_element;
+    }
+    endq = new_element;
+
+    if(q->current == temp) {
+      q->current = new_element;
+    }
+    if(q->previous == temp) {
+      q->previous = new_element;
+    }
+    if(ctx != 0 && ctx->current == temp) {
+      ctx->current = new_element;
+    }
+    if(ctx != 0 && ctx->previous == temp) {
+      ctx->previous = new_element;
+    }
+  }
+
+  q->queue = list;
+  release_list(q->shared);
+  q->shared = 0;
+  list_relinked(q);
+}
+
+
+
+////////////////////////////
+// lock-free backend of concurrent queues
+////////////////////////////
+
+// Concurrent queues are lock-free skiplists sorted by (priority, order
+// of addition), after Herlihy and Shavit's lock-free skiplist and its
+// priority queue.  A node is deleted at a level when its own next
+// pointer at that level is marked (bit 0).  Removing claims the first
+// unclaimed node of level 0 with its 'taken' flag, marks its levels top
+// down, then unlinks it with a search.  Unlinked nodes are freed with
+// epoch based reclamation: they wait until every thread which could
+// still hold a pointer to them has left its queue operation.
+
+#define LF_MAX_LEVEL 24
+#define LF_INSERTING 0
+#define LF_LINKED 1
+#define LF_ORPHANED 2		// removed while still being linked
+#define LF_MARKED(ptr) (((uintptr_t) (ptr)) & 1)
+#define LF_UNMARKED(ptr) ((Lf_node *) (((uintptr_t) (ptr)) & ~(uintptr_t) 1))
+#define LF_MARK(ptr) ((Lf_node *) (((uintptr_t) (ptr)) | 1))
+
+#define EPOCH_RETIRE_BATCH 64
+
+typedef struct _Lf_node
+{
+  int priority;
+  unsigned long long order;	// addition order among equal priorities
+  int level;			// # of levels the node is linked at
+  int taken;			// claimed by a remove
+  int state;			// LF_INSERTING, LF_LINKED or LF_ORPHANED
+  struct _Lf_node *retired_next;	// in the retired list of a thread
+  struct _Lf_node *next[];	// 'level' next pointers, then the element
+} Lf_node;
+
+struct Concurrent_queue
+{
+  Lf_node *head;		// sentinels linked at every level
+  Lf_node *tail;
+  unsigned long long order;	// addition counter
+};
+
+// a thread taking part in epoch based reclamation.
+typedef struct Epoch_record
+{
+  struct Epoch_record *next;	// in the registry, records are never freed
+  int owned;			// by a live thread
+  int active;			// in a queue operation
+  unsigned long epoch;		// global epoch on entering the operation
+  Lf_node *retired[3];		// unlinked nodes, by epoch modulo 3
+  unsigned long retired_epoch[3];
+  int retired_count;		// since the last attempt to advance the epoch
+} Epoch_record;
+
+static Epoch_record *epoch_records;
+static unsigned long global_epoch;
+static __thread Epoch_record *thread_record;
+static __thread unsigned long long level_state;
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+
+
+static void release_epoch_record(void *record) {
+
+  __atomic_store_n(&((Epoch_record *) record)->owned, FALSE, __ATOMIC_RELEASE);
+}
+
+
+static void create_epoch_key(void) {
+
+  pthread_key_create(&epoch_key, release_epoch_record);
+}
+
+
+// record of the calling thread: an unowned one, left with its retired
+// nodes by a thread which exited, or a new one.
+static Epoch_record *epoch_record(void) {
+
+  Epoch_record *record = thread_record;
+  int unowned;
+
+  if(record != 0) {
+    return record;
+  }
+
+  pthread_once(&epoch_key_once, create_epoch_key);
+  for (record = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE); record != 0;
+       record = record->next) {
+    unowned = FALSE;
+    if(__atomic_compare_exchange_n(&record->owned, &unowned, TRUE, FALSE,
+				   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+  if(record == 0) {
+    record = calloc(1, sizeof(Epoch_record));
+    if(record == 0) {
+      assert(!"Malloc failed in function epoch_record()\n");
+      exit(1);
+    }
+    record->owned = TRUE;
+    record->next = __atomic_load_n(&epoch_records, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&epoch_records, &record->next, record, FALSE,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+  }
+
+  pthread_setspecific(epoch_key, record);
+  thread_record = record;
+  return record;
+}
+
+
+static void epoch_enter(void) {
+
+  Epoch_record *record = epoch_record();
+
+  __atomic_store_n(&record->epoch, __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST),
+		   __ATOMIC_SEQ_CST);
+  __atomic_store_n(&record->active, TRUE, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+
+static void epoch_exit(void) {
+
+  __atomic_store_n(&thread_record->active, FALSE, __ATOMIC_RELEASE);
+}
+
+
+// moves to the next epoch once every active thread has seen this one.
+static void epoch_try_advance(void) {
+
+  unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+  Epoch_record *record;
+
+  for (record = __atomic_load_n(&epoch_records, __ATOMIC_ACQUIRE); record != 0;
+       record = record->next) {
+    if(__atomic_load_n(&record->active, __ATOMIC_SEQ_CST) &&
+       __atomic_load_n(&record->epoch, __ATOMIC_SEQ_CST) != epoch) {
+      return;
+    }
+  }
+  __atomic_compare_exchange_n(&global_epoch, &epoch, epoch + 1, FALSE,
+			      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+
+// frees the nodes retired two epochs or more before 'epoch': no thread
+// can reach them any more.
+static void epoch_reclaim(Epoch_record * record, unsigned long epoch) {
+
+  Lf_node *node;
+
+  for (int slot = 0; slot < 3; slot++) {
+    if(record->retired[slot] != 0 && record->retired_epoch[slot] + 2 <= epoch) {
+      while ((node = record->retired[slot]) != 0) {
+	record->retired[slot] = node->retired_next;
+	free(node);
+	COUNT(frees, 1);
+      }
+    }
+  }
+}
+
+
+// hands an unlinked node over for freeing.  Called in a queue operation.
+static void epoch_retire(Lf_node * node) {
+
+  Epoch_record *record = thread_record;
+  unsigned long epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+  int slot = (int)(epoch % 3);
+
+  epoch_reclaim(record, epoch);
+  node->retired_next = record->retired[slot];
+  record->retired[slot] = node;
+  record->retired_epoch[slot] = epoch;
+  if(++record->retired_count >= EPOCH_RETIRE_BATCH) {
+    record->retired_count = 0;
+    epoch_try_advance();
+  }
+}
+
+
+static void *lf_info(Lf_node * node) {
+
+  // the element follows the next pointers, 16 byte aligned
+  return (char *)node + ((sizeof(Lf_node) + node->level * sizeof(Lf_node *) + 15) & ~(size_t) 15);
+}
+
+
+static Lf_node *lf_new_node(int level, int elementsize) {
+
+  Lf_node *node;
+  size_t size = ((sizeof(Lf_node) + level * sizeof(Lf_node *) + 15) & ~(size_t) 15) + elementsize;
+
+  node = calloc(1, size);
+  if(node == 0) {
+    assert(!"Malloc failed in function add_to_queue()\n");
+    exit(1);
+  }
+  COUNT(mallocs, 1);
+  node->level = level;
+  return node;
+}
+
+
+// levels of a new node: 1 with probability 1/2, 2 with 1/4...
+static int lf_random_level(void) {
+
+  if(level_state == 0) {
+    level_state = (uintptr_t) & level_state ^ 0x9e3779b97f4a7c15ULL;
+  }
+  level_state ^= level_state >> 12;
+  level_state ^= level_state << 25;
+  level_state ^= level_state >> 27;
+  return 1 + __builtin_ctzll((level_state * 0x2545f4914f6cdd1dULL) | (1ULL << (LF_MAX_LEVEL - 1)));
+}
+
+
+// does 'node' go before the key (priority, order)?
+static int lf_before(struct Concurrent_queue *cq, Lf_node * node, int priority,
+		     unsigned long long order) {
+
+  if(node == cq->head) {
+    return TRUE;
+  }
+  if(node == cq->tail) {
+    return FALSE;
+  }
+  return node->priority < priority || (node->priority == priority && node->order < order);
+}
+
+
+// finds, at every level, the last node before the key and the first
+// one after or at it, unlinking the marked nodes on the way.
+static void lf_find(struct Concurrent_queue *cq, int priority, unsigned long long order,
+		    Lf_node ** preds, Lf_node ** succs) {
+
+  Lf_node *pred, *curr, *succ;
+
+retry:
+  pred = cq->head;
+  for (int level = LF_MAX_LEVEL - 1; level >= 0; level--) {
+    curr = LF_UNMARKED(__atomic_load_n(&pred->next[level], __ATOMIC_ACQUIRE));
+    for (;;) {
+      COUNT(add_walked, 1);
+      succ = __atomic_load_n(&curr->next[level], __ATOMIC_ACQUIRE);
+      while (LF_MARKED(succ)) {
+	Lf_node *expected = curr;
+	if(!__atomic_compare_exchange_n(&pred->next[level], &expected, LF_UNMARKED(succ),
+					FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	  goto retry;
+	}
+	curr = LF_UNMARKED(succ);
+	succ = __atomic_load_n(&curr->next[level], __ATOMIC_ACQUIRE);
+      }
+      if(!lf_before(cq, curr, priority, order)) {
+	break;
+      }
+      pred = curr;
+      curr = LF_UNMARKED(succ);
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+}
+
+
+static void lf_add(Queue * q, void *element, int priority) {
+
+  struct Concurrent_queue *cq = q->concurrent;
+  Lf_node *preds[LF_MAX_LEVEL], *succs[LF_MAX_LEVEL], *node, *old;
+  int expected = LF_INSERTING, removed;
+
+  node = lf_new_node(lf_random_level(), q->elementsize);
+  memcpy(lf_info(node), element, q->elementsize);
+  COUNT(memcpy_bytes, q->elementsize);
+  node->priority = priority;
+  node->order = __atomic_fetch_add(&cq->order, 1, __ATOMIC_RELAXED);
+
+  epoch_enter();
+
+  // linking level 0 adds the element
+  do {
+    lf_find(cq, priority, node->order, preds, succs);
+    for (int level = 0; level < node->level; level++) {
+      __atomic_store_n(&node->next[level], succs[level], __ATOMIC_RELAXED);
+    }
+  } while (!__atomic_compare_exchange_n(&preds[0]->next[0], &succs[0], node, FALSE,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  // counted once it can be found: a consumer seeing the count can take it
+  __atomic_fetch_add(&q->queuelength, 1, __ATOMIC_RELEASE);
+
+  // the upper levels only speed searches up; stop if the node is removed
+  for (int level = 1; level < node->level; level++) {
+    for (;;) {
+      old = __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+      if(LF_MARKED(old)) {
+	goto linked;
+      }
+      if(old != succs[level] &&
+	 !__atomic_compare_exchange_n(&node->next[level], &old, succs[level], FALSE,
+				      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	continue;
+      }
+      if(__atomic_compare_exchange_n(&preds[level]->next[level], &succs[level], node, FALSE,
+				     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+	break;
+      }
+      lf_find(cq, priority, node->order, preds, succs);
+      if(succs[0] != node) {
+	goto linked;
+      }
+    }
+  }
+
+linked:
+  // a remove which took the node meanwhile may have searched before this
+  // thread linked an upper level: search again, still in the epoch, so
+  // that the node is unlinked everywhere before either thread retires it.
+  // The fence pairs with the one in lf_remove(): either the mark is seen
+  // here or the remove's search sees the last link.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  removed = LF_MARKED(__atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE));
+  if(removed) {
+    lf_find(cq, priority, node->order, preds, succs);
+  }
+  // a remove which took the node meanwhile leaves it to this thread
+  if(!__atomic_compare_exchange_n(&node->state, &expected, LF_LINKED, FALSE,
+				  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    if(!removed) {
+      lf_find(cq, priority, node->order, preds, succs);
+    }
+    epoch_retire(node);
+  }
+
+  epoch_exit();
+}
+
+
+static int lf_remove(Queue * q, void *element) {
+
+  struct Concurrent_queue *cq = q->concurrent;
+  Lf_node *preds[LF_MAX_LEVEL], *succs[LF_MAX_LEVEL], *node;
+  int expected = LF_INSERTING;
+
+  epoch_enter();
+
+  for (node = LF_UNMARKED(__atomic_load_n(&cq->head->next[0], __ATOMIC_ACQUIRE));
+       node != cq->tail; node = LF_UNMARKED(__atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE))) {
+    if(!__atomic_load_n(&node->taken, __ATOMIC_RELAXED) &&
+       !__atomic_exchange_n(&node->taken, TRUE, __ATOMIC_ACQ_REL)) {
+      memcpy(element, lf_info(node), q->elementsize);
+      COUNT(memcpy_bytes, q->elementsize);
+      __atomic_fetch_sub(&q->queuelength, 1, __ATOMIC_RELAXED);
+
+      // delete the node at every level, top down, then unlink it
+      for (int level = node->level - 1; level >= 0; level--) {
+	__atomic_fetch_or((uintptr_t *) & node->next[level], 1, __ATOMIC_ACQ_REL);
+      }
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      lf_find(cq, node->priority, node->order, preds, succs);
+      if(!__atomic_compare_exchange_n(&node->state, &expected, LF_ORPHANED, FALSE,
+				      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	epoch_retire(node);
+      }
+
+      epoch_exit();
+      return TRUE;
+    }
+  }
+
+  epoch_exit();
+  return FALSE;
+}
+
+
+static void lf_destroy(Queue * q) {
+
+  struct Concurrent_queue *cq = q->concurrent;
+  Lf_node *node, *next;
+
+  for (node = cq->head; node != 0; node = next) {
+    next = node == cq->tail ? 0 : LF_UNMARKED(node->next[0]);
+    free(node);
+    COUNT(frees, 1);
+  }
+  free(cq);
+  q->concurrent = 0;
+  q->queuelength = 0;
+}
+
+
+void init_concurrent_queue(Queue * q, int elementsize) {
+
+  init_queue(q, elementsize, TRUE, 0, FALSE);
+  q->concurrent = malloc(sizeof(struct Concurrent_queue));
+  if(q->concurrent == 0) {
+    assert(!"Malloc failed in function init_concurrent_queue()\n");
+    exit(1);
+  }
+  q->concurrent->head = lf_new_node(LF_MAX_LEVEL, 0);
+  q->concurrent->tail = lf_new_node(LF_MAX_LEVEL, 0);
+  q->concurrent->order = 0;
+  for (int level = 0; level < LF_MAX_LEVEL; level++) {
+    q->concurrent->head->next[level] = q->concurrent->tail;
+  }
+}
+
+
 void
 init_queue(Queue * q, int elementsize, int duplicates,
 	   int (*compare) (void *e1, void *e2), int priority_is_tag_only) {
@@ -37,21 +849,78 @@ init_queue(Queue * q, int elementsize, int duplicates,
   q->duplicates = duplicates;
   q->compare = compare;
   q->priority_is_tag_only = priority_is_tag_only;
+  q->concurrent = 0;
+  q->shared_reads = FALSE;
+  q->shared = 0;
+  q->index = 0;
+  memset(q->tails, 0, sizeof(q->tails));
   nolock_rewind_queue(q);
   q->lock = initial_mutex;
 
 }
 
 
+void share_reads(Queue * q) {
+
+  pthread_rwlockattr_t attributes;
+
+  pthread_rwlockattr_init(&attributes);
+#if defined(__GLIBC__)
+  // glibc lets readers in while a writer waits unless told otherwise;
+  // other systems (macOS) already prefer writers.
+  pthread_rwlockattr_setkind_np(&attributes,
+				PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+  if(pthread_rwlock_init(&(q->rwlock), &attributes) != 0) {
+    assert(!"Cannot create lock in function share_reads()\n");
+    exit(1);
+  }
+  pthread_rwlockattr_destroy(&attributes);
+  q->shared_reads = TRUE;
+}
+
+
+void index_queue(Queue * q) {
+
+  assert(q->concurrent == 0 && !q->priority_is_tag_only &&
+	 "index_queue() needs a list sorted by priority");
+
+  // lock entire queue
+  lock_queue(q);
+
+  if(q->index == 0) {
+    q->index = calloc(1, sizeof(struct Priority_index));
+    if(q->index == 0) {
+      assert(!"Malloc failed in function index_queue()\n");
+      exit(1);
+    }
+    index_rebuild(q);
+  }
+
+  // release lock on queue
+  unlock_queue(q);
+}
+
+
 void destroy_queue(Queue * q) {
 
+  if(q->concurrent != 0) {
+    lf_destroy(q);
+    return;
+  }
+
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
 
   nolock_destroy_queue(q);
+  if(q->index != 0) {
+    free(q->index->entries);
+    free(q->index);
+    q->index = 0;
+  }
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 }
 
 
@@ -59,12 +928,23 @@ void nolock_destroy_queue(Queue * q) {
 
   Queue_element temp;
 
+  if(q != 0 && q->shared != 0) {
+    release_list(q->shared);
+    q->shared = 0;
+    q->queue = 0;
+    q->queuelength = 0;
+  }
+  if(q != 0) {
+    memset(q->tails, 0, sizeof(q->tails));
+  }
+  if(q != 0 && q->index != 0) {
+    q->index->count = 0;
+  }
   if(q != 0) {
     while (q->queue != 0) {
-      free(q->queue->info);
       temp = q->queue;
       q->queue = q->queue->next;
-      free(temp);
+      free_element(temp);
       (q->queuelength)--;
     }
   }
@@ -79,12 +959,12 @@ int element_in_queue(Queue * q, void *element) {
 
   int found;
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
 
   found = nolock_element_in_queue(q, element);
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 
   return found;
 }
@@ -96,7 +976,8 @@ int nolock_element_in_queue(Queue * q, void *element) {
   if(q->queue != 0) {
     nolock_rewind_queue(q);
     while (!end_of_queue(q) && !found) {
-        
+      COUNT(find_walked, 1);
+      PREFETCH_NEXT(q->current);
       if(q->compare(element, q->current->info) == 0) {
 	found = 1;
       }
@@ -116,23 +997,19 @@ int nolock_element_in_queue(Queue * q, void *element) {
 
 void nolock_add_to_queue(Queue * q, void *element, int priority) {
 
-  Queue_element new_element, ptr, prev = 0;
+  Queue_element new_element, ptr, tail, prev = 0;
 
   if(!q->queue ||
      (q->queue && (q->duplicates || !nolock_element_in_queue(q, element)))) {
 
-    new_element = (Queue_element) malloc(sizeof(struct _Queue_element));
+    new_element = alloc_element(q->elementsize);
     if(new_element == 0) {
       assert(!"Malloc failed in function add_to_queue()\n");
       exit(1);
     }
-    new_element->info = (void *)malloc(q->elementsize);
-    if(new_element->info == 0) {
-      assert(!"Malloc failed in function add_to_queue()\n");
-      exit(1);
-    }
 
     memcpy(new_element->info, element, q->elementsize);
+    COUNT(memcpy_bytes, q->elementsize);
 
     new_element->priority = priority;
 
@@ -146,9 +1023,21 @@ void nolock_add_to_queue(Queue * q, void *element, int priority) {
       new_element->next = q->queue;
       q->queue = new_element;
     }
+    else if((tail = *tail_slot(q, priority)) != 0 &&
+	    tail->priority == priority) {
+      new_element->next = tail->next;
+      tail->next = new_element;
+    }
+    else if(q->index != 0) {
+      prev = index_find(q, priority);
+      new_element->next = prev->next;
+      prev->next = new_element;
+    }
     else {
       ptr = q->queue;
       while (ptr != 0 && priority >= ptr->priority) {
+	COUNT(add_walked, 1);
+	PREFETCH_NEXT(ptr);
 	prev = ptr;
 	ptr = ptr->next;
       }
@@ -157,6 +1046,7 @@ void nolock_add_to_queue(Queue * q, void *element, int priority) {
       prev->next = new_element;
     }
 
+    element_linked(q, new_element);
     nolock_rewind_queue(q);
   }
 }
@@ -164,30 +1054,92 @@ void nolock_add_to_queue(Queue * q, void *element, int priority) {
 
 void add_to_queue(Queue * q, void *element, int priority) {
 
+  if(q->concurrent != 0) {
+    lf_add(q, element, priority);
+    return;
+  }
+
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
 
+  nolock_own_list(q, 0);
   nolock_add_to_queue(q, element, priority);
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 
 }
 
 
 int empty_queue(Queue * q) {
 
+  if(q->concurrent != 0) {
+    // below 0 while an element is removed before its addition is counted
+    return __atomic_load_n(&q->queuelength, __ATOMIC_ACQUIRE) <= 0;
+  }
   return q->queue == 0;
 }
 
 
 
-void remove_from_front(Queue * q, void *element) {
+static void nolock_remove_from_front(Queue * q, void *element) {
 
   Queue_element temp;
 
+  memcpy(element, q->queue->info, q->elementsize);
+  COUNT(memcpy_bytes, q->elementsize);
+
+  temp = q->queue;
+  element_unlinked(q, temp, 0);
+  q->queue = q->queue->next;
+  if(q->shared == 0) {
+    free_element(temp);
+  }
+  (q->queuelength)--;
+
+  nolock_rewind_queue(q);
+}
+
+
+int try_remove_from_front(Queue * q, void *element) {
+
+  int removed = FALSE;
+
+  if(q->concurrent != 0) {
+    return lf_remove(q, element);
+  }
+
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
+
+  if(q->queue != 0) {
+    nolock_remove_from_front(q, element);
+    removed = TRUE;
+  }
+
+  // release lock on queue
+  unlock_queue(q);
+
+  return removed;
+}
+
+
+void remove_from_front(Queue * q, void *element) {
+
+  if(q->concurrent != 0) {
+#if defined(CONSISTENCY_CHECKING)
+    if(!lf_remove(q, element)) {
+      assert(!"NULL pointer in function remove_from_front()\n");
+      exit(1);
+    }
+#else
+    lf_remove(q, element);
+#endif
+    return;
+  }
+
+  // lock entire queue
+  lock_queue(q);
 
 #if defined(CONSISTENCY_CHECKING)
   if(q->queue == 0) {
@@ -197,20 +1149,62 @@ void remove_from_front(Queue * q, void *element) {
   else
 #endif
   {
+    nolock_remove_from_front(q, element);
+  }
+
+  // release lock on queue
+  unlock_queue(q);
+}
 
-    memcpy(element, q->queue->info, q->elementsize);
 
-    free(q->queue->info);
-    temp = q->queue;
-    q->queue = q->queue->next;
-    free(temp);
-    (q->queuelength)--;
+
+int remove_while_priority_le(Queue * q, int priority, void *elements, int max) {
+
+  Queue_element first, last = 0, temp;
+  int count = 0;
+
+  // lock entire queue
+  lock_queue(q);
+
+  // copy the prefix out, then detach it with one splice
+  first = q->queue;
+  for (temp = first; temp != 0 && count < max && temp->priority <= priority;
+       temp = temp->next) {
+    memcpy((char *)elements + (size_t)count * q->elementsize, temp->info,
+	   q->elementsize);
+    COUNT(memcpy_bytes, q->elementsize);
+    element_unlinked(q, temp, 0);
+    last = temp;
+    count++;
+  }
+  if(last != 0 && q->shared != 0) {
+    // shared nodes stay in the list, the queue just moves past them
+    q->queue = last->next;
+    q->queuelength -= count;
+    first = 0;
+  }
+  else if(last != 0) {
+    q->queue = last->next;
+    last->next = 0;
+    q->queuelength -= count;
+  }
+  else {
+    first = 0;
   }
 
   nolock_rewind_queue(q);
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
+
+  // the detached nodes are private now
+  while (first != 0) {
+    temp = first;
+    first = first->next;
+    free_element(temp);
+  }
+
+  return count;
 }
 
 
@@ -218,7 +1212,7 @@ void remove_from_front(Queue * q, void *element) {
 void peek_at_current(Queue * q, void *element) {
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue_shared(q);
 
 #if defined(CONSISTENCY_CHECKING)
   if(q->queue == 0 || q->current == 0) {
@@ -230,10 +1224,39 @@ void peek_at_current(Queue * q, void *element) {
   {
 
     memcpy(element, (q->current)->info, q->elementsize);
+    COUNT(memcpy_bytes, q->elementsize);
 
     // release lock on queue
-    pthread_mutex_unlock(&(q->lock));
+    unlock_queue(q);
+  }
+}
+
+
+int with_front(Queue * q, int (*fn) (void *element, int priority, void *ctx),
+	       void *ctx) {
+
+  int result;
+
+  // lock entire queue
+  lock_queue(q);
+
+  nolock_own_list(q, 0);
+
+#if defined(CONSISTENCY_CHECKING)
+  if(q->queue == 0) {
+    assert(!"NULL pointer in function with_front()\n");
+    exit(1);
+  }
+  else
+#endif
+  {
+    result = fn(q->queue->info, q->queue->priority, ctx);
   }
+
+  // release lock on queue
+  unlock_queue(q);
+
+  return result;
 }
 
 
@@ -242,7 +1265,9 @@ void *pointer_to_current(Queue * q) {
   void *data;
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
+
+  nolock_own_list(q, 0);
 
 #if defined(CONSISTENCY_CHECKING)
   if(q->queue == 0 || q->current == 0) {
@@ -256,7 +1281,7 @@ void *pointer_to_current(Queue * q) {
     data = (q->current)->info;
 
     // release lock on queue
-    pthread_mutex_unlock(&(q->lock));
+    unlock_queue(q);
 
     return data;
   }
@@ -269,7 +1294,7 @@ int current_priority(Queue * q) {
   int priority;
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue_shared(q);
 
 #if defined(CONSISTENCY_CHECKING)
   if(q->queue == 0 || q->current == 0) {
@@ -283,7 +1308,7 @@ int current_priority(Queue * q) {
     priority = (q->current)->priority;
 
     // release lock on queue
-    pthread_mutex_unlock(&(q->lock));
+    unlock_queue(q);
 
     return priority;
   }
@@ -294,7 +1319,9 @@ int current_priority(Queue * q) {
 void update_current(Queue * q, void *element) {
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
+
+  nolock_own_list(q, 0);
 
 #if defined(CONSISTENCY_CHECKING)
   if(q->queue == 0 || q->current == 0) {
@@ -305,10 +1332,11 @@ void update_current(Queue * q, void *element) {
 #endif
   {
     memcpy(q->current->info, element, q->elementsize);
+    COUNT(memcpy_bytes, q->elementsize);
   }
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 }
 
 
@@ -318,7 +1346,9 @@ void delete_current(Queue * q) {
   Queue_element temp;
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
+
+  nolock_own_list(q, 0);
 
 #if defined(CONSISTENCY_CHECKING)
   if(q->queue == 0 || q->current == 0) {
@@ -328,9 +1358,8 @@ void delete_current(Queue * q) {
   else
 #endif
   {
-
-    free(q->current->info);
     temp = q->current;
+    element_unlinked(q, temp, q->previous);
 
     if(q->previous == 0) {	// deletion at beginning
       q->queue = q->queue->next;
@@ -341,13 +1370,13 @@ void delete_current(Queue * q) {
       q->current = q->previous->next;
     }
 
-    free(temp);
+    free_element(temp);
     (q->queuelength)--;
 
   }
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 
 }
 
@@ -363,12 +1392,12 @@ int end_of_queue(Queue * q) {
 void next_element(Queue * q) {
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
 
   nolock_next_element(q);
 
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 }
 
 
@@ -396,11 +1425,11 @@ void nolock_next_element(Queue * q) {
 void rewind_queue(Queue * q) {
 
   // lock entire queue
-  pthread_mutex_lock(&(q->lock));
+  lock_queue(q);
 
   nolock_rewind_queue(q);
   // release lock on queue
-  pthread_mutex_unlock(&(q->lock));
+  unlock_queue(q);
 }
 
 void nolock_rewind_queue(Queue * q) {
@@ -413,6 +1442,10 @@ void nolock_rewind_queue(Queue * q) {
 
 int queue_length(Queue * q) {
 
+  if(q->concurrent != 0) {
+    int length = __atomic_load_n(&q->queuelength, __ATOMIC_ACQUIRE);
+    return length > 0 ? length : 0;
+  }
   return q->queuelength;
 }
 
@@ -421,13 +1454,8 @@ void copy_queue(Queue * q1, Queue * q2) {
 
   Queue_element temp, new_element, endq1;
 
-  // to avoid deadlock, this function acquires a global package
-  // lock!
-  pthread_mutex_lock(&global_lock);
-
   // lock entire queues q1, q2
-  pthread_mutex_lock(&(q1->lock));
-  pthread_mutex_lock(&(q2->lock));
+  lock_queues(q1, q2);
 
   // free elements in q1 before copy 
 
@@ -445,19 +1473,13 @@ void copy_queue(Queue * q1, Queue * q2) {
   endq1 = q1->queue;
 
   while (temp != 0) {
-    new_element = (Queue_element) malloc(sizeof(struct _Queue_element));
-
+    new_element = alloc_element(q1->elementsize);
     if(new_element == 0) {
       assert(!"Malloc failed in function copy_queue()\n");
       exit(1);
     }
-
-    new_element->info = (void *)malloc(q1->elementsize);
-    if(new_element->info == 0) {
-      assert(!"Malloc failed in function copy_queue()\n");
-      exit(1);
-    }
     memcpy(new_element->info, temp->info, q1->elementsize);
+    COUNT(memcpy_bytes, q1->elementsize);
 
     new_element->priority = temp->priority;
     new_element->next = 0;
@@ -474,14 +1496,51 @@ void copy_queue(Queue * q1, Queue * q2) {
     temp = temp->next;
   }
 
+  list_relinked(q1);
   nolock_rewind_queue(q1);
 
   // release locks on q1, q2
-  pthread_mutex_unlock(&(q2->lock));
-  pthread_mutex_unlock(&(q1->lock));
+  unlock_queues(q1, q2);
+
+}
+
+
+
+void snapshot_queue(Queue * q1, Queue * q2) {
+
+  // lock entire queues q1, q2
+  lock_queues(q1, q2);
+
+  // free elements in q1 before sharing
+
+  nolock_destroy_queue(q1);
+
+  q1->elementsize = q2->elementsize;
+  q1->duplicates = q2->duplicates;
+  q1->compare = q2->compare;
+  q1->priority_is_tag_only = q2->priority_is_tag_only;
+
+  if(q2->queue != 0) {
+    if(q2->shared == 0) {
+      q2->shared = malloc(sizeof(struct Shared_list));
+      if(q2->shared == 0) {
+	assert(!"Malloc failed in function snapshot_queue()\n");
+	exit(1);
+      }
+      q2->shared->references = 1;
+      q2->shared->head = q2->queue;
+    }
+    __atomic_fetch_add(&q2->shared->references, 1, __ATOMIC_RELAXED);
+    q1->shared = q2->shared;
+    q1->queue = q2->queue;
+    q1->queuelength = q2->queuelength;
+  }
+
+  list_relinked(q1);
+  nolock_rewind_queue(q1);
 
-  // release global package lock
-  pthread_mutex_unlock(&global_lock);
+  // release locks on q1, q2
+  unlock_queues(q1, q2);
 
 }
 
@@ -492,13 +1551,8 @@ int equal_queues(Queue * q1, Queue * q2) {
   Queue_element temp1, temp2;
   int same = TRUE;
 
-  // to avoid deadlock, this function acquires a global package
-  // lock!
-  pthread_mutex_lock(&global_lock);
-
   // lock entire queues q1, q2
-  pthread_mutex_lock(&(q1->lock));
-  pthread_mutex_lock(&(q2->lock));
+  lock_queues_shared(q1, q2);
 
   if(q1->queuelength != q2->queuelength || q1->elementsize != q2->elementsize) {
     same = FALSE;
@@ -515,43 +1569,139 @@ int equal_queues(Queue * q1, Queue * q2) {
   }
 
   // release locks on q1, q2
-  pthread_mutex_unlock(&(q2->lock));
-  pthread_mutex_unlock(&(q1->lock));
-
-  // release global package lock
-  pthread_mutex_unlock(&global_lock);
+  unlock_queues(q1, q2);
 
   return same;
 }
 
 
-void merge_queues(Queue * q1, Queue * q2) {
+// can q2 be merged into q1 in one pass?  Both lists must be sorted,
+// and duplicates in q1 need an element search for every addition.
+static int sorted_merge(Queue * q1, Queue * q2) {
+
+  return q1->duplicates && !q1->priority_is_tag_only && !q2->priority_is_tag_only;
+}
 
-  Queue_element temp;
 
-  // to avoid deadlock, this function acquires a global package
-  // lock!
-  pthread_mutex_lock(&global_lock);
+// links 'new_element' into the sorted q1, after the elements with
+// lower or equal priority, searching from 'prev' (0 for the front).
+// Returns the element, the next search start: the elements merged
+// after it have greater or equal priorities.
+static Queue_element nolock_link_after(Queue * q1, Queue_element prev,
+				       Queue_element new_element) {
+
+  Queue_element ptr = prev != 0 ? prev->next : q1->queue;
+
+  while (ptr != 0 && new_element->priority >= ptr->priority) {
+    COUNT(add_walked, 1);
+    prev = ptr;
+    ptr = ptr->next;
+  }
+
+  new_element->next = ptr;
+  if(prev == 0) {
+    q1->queue = new_element;
+  }
+  else {
+    prev->next = new_element;
+  }
+  (q1->queuelength)++;
+
+  return new_element;
+}
+
+
+void merge_queues(Queue * q1, Queue * q2) {
+
+  Queue_element temp, new_element, prev = 0;
 
   // lock entire queues q1, q2
-  pthread_mutex_lock(&(q1->lock));
-  pthread_mutex_lock(&(q2->lock));
+  lock_queues(q1, q2);
+
+  nolock_own_list(q1, 0);
 
   temp = q2->queue;
 
-  while (temp != 0) {
-    nolock_add_to_queue(q1, temp->info, temp->priority);
-    temp = temp->next;
+  if(sorted_merge(q1, q2)) {
+    // two-pointer merge, q1 is walked once
+    while (temp != 0) {
+      new_element = alloc_element(q1->elementsize);
+      if(new_element == 0) {
+	assert(!"Malloc failed in function merge_queues()\n");
+	exit(1);
+      }
+      memcpy(new_element->info, temp->info, q1->elementsize);
+      COUNT(memcpy_bytes, q1->elementsize);
+      new_element->priority = temp->priority;
+
+      prev = nolock_link_after(q1, prev, new_element);
+      temp = temp->next;
+    }
+  }
+  else {
+    while (temp != 0) {
+      nolock_add_to_queue(q1, temp->info, temp->priority);
+      temp = temp->next;
+    }
   }
 
+  list_relinked(q1);
   nolock_rewind_queue(q1);
 
   // release locks on q1, q2
-  pthread_mutex_unlock(&(q2->lock));
-  pthread_mutex_unlock(&(q1->lock));
+  unlock_queues(q1, q2);
+
+}
+
 
-  // release global package lock
-  pthread_mutex_unlock(&global_lock);
+
+void splice_queues(Queue * q1, Queue * q2) {
+
+  Queue_element temp, prev = 0;
+
+  // lock entire queues q1, q2
+  lock_queues(q1, q2);
+
+  nolock_own_list(q1, 0);
+  nolock_own_list(q2, 0);
+
+  if(sorted_merge(q1, q2)) {
+    // two-pointer merge, moving the nodes of q2
+    while (q2->queue != 0) {
+      temp = q2->queue;
+      q2->queue = temp->next;
+      prev = nolock_link_after(q1, prev, temp);
+    }
+    q2->queuelength = 0;
+  }
+  else {
+    // each node of q2 in turn, placed as nolock_add_to_queue() would
+    while (q2->queue != 0) {
+      temp = q2->queue;
+      q2->queue = temp->next;
+      if(q1->queue != 0 && !q1->duplicates &&
+	 nolock_element_in_queue(q1, temp->info)) {
+	free_element(temp);
+      }
+      else if(q1->priority_is_tag_only) {
+	temp->next = q1->queue;
+	q1->queue = temp;
+	(q1->queuelength)++;
+      }
+      else {
+	nolock_link_after(q1, 0, temp);
+      }
+    }
+    q2->queuelength = 0;
+  }
+
+  list_relinked(q1);
+  list_relinked(q2);
+  nolock_rewind_queue(q1);
+  nolock_rewind_queue(q2);
+
+  // release locks on q1, q2
+  unlock_queues(q1, q2);
 
 }
 
@@ -560,7 +1710,7 @@ void merge_queues(Queue * q1, Queue * q2) {
 void local_peek_at_current(Context * ctx, void *element) {
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue_shared(ctx->queue);
 
 #if defined(CONSISTENCY_CHECKING)
   if(ctx->queue == 0 || ctx->current == 0) {
@@ -572,9 +1722,10 @@ void local_peek_at_current(Context * ctx, void *element) {
   {
 
     memcpy(element, (ctx->current)->info, ctx->queue->elementsize);
+    COUNT(memcpy_bytes, ctx->queue->elementsize);
 
     // release lock on queue
-    pthread_mutex_unlock(&(ctx->queue->lock));
+    unlock_queue(ctx->queue);
 
   }
 }
@@ -585,7 +1736,9 @@ void *local_pointer_to_current(Context * ctx) {
   void *data;
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue(ctx->queue);
+
+  nolock_own_list(ctx->queue, ctx);
 
 #if defined(CONSISTENCY_CHECKING)
 
@@ -600,7 +1753,7 @@ void *local_pointer_to_current(Context * ctx) {
     data = (ctx->current)->info;
 
     // release lock on queue
-    pthread_mutex_unlock(&(ctx->queue->lock));
+    unlock_queue(ctx->queue);
 
     return data;
   }
@@ -612,7 +1765,7 @@ int local_current_priority(Context * ctx) {
   int priority;
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue_shared(ctx->queue);
 
 #if defined(CONSISTENCY_CHECKING)
   if(ctx->queue == 0 || ctx->current == 0) {
@@ -625,7 +1778,7 @@ int local_current_priority(Context * ctx) {
     priority = (ctx->current)->priority;
 
     // release lock on queue
-    pthread_mutex_unlock(&(ctx->queue->lock));
+    unlock_queue(ctx->queue);
 
     return priority;
   }
@@ -636,7 +1789,9 @@ int local_current_priority(Context * ctx) {
 void local_update_current(Context * ctx, void *element) {
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue(ctx->queue);
+
+  nolock_own_list(ctx->queue, ctx);
 
 #if defined(CONSISTENCY_CHECKING)
   if(ctx->queue == 0 || ctx->current == 0) {
@@ -647,10 +1802,11 @@ void local_update_current(Context * ctx, void *element) {
 #endif
   {
     memcpy(ctx->current->info, element, ctx->queue->elementsize);
+    COUNT(memcpy_bytes, ctx->queue->elementsize);
   }
 
   // release lock on queue
-  pthread_mutex_unlock(&(ctx->queue->lock));
+  unlock_queue(ctx->queue);
 }
 
 
@@ -660,7 +1816,9 @@ void local_delete_current(Context * ctx) {
   Queue_element temp;
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue(ctx->queue);
+
+  nolock_own_list(ctx->queue, ctx);
 
 #if defined(CONSISTENCY_CHECKING)
   if(ctx->queue == 0 || ctx->current == 0) {
@@ -670,9 +1828,8 @@ void local_delete_current(Context * ctx) {
   else
 #endif
   {
-
-    free(ctx->current->info);
     temp = ctx->current;
+    element_unlinked(ctx->queue, temp, ctx->previous);
 
     if(ctx->previous == 0) {	// deletion at beginning
       ctx->queue->queue = ctx->queue->queue->next;
@@ -683,13 +1840,13 @@ void local_delete_current(Context * ctx) {
       ctx->current = ctx->current->next;
     }
 
-    free(temp);
+    free_element(temp);
     (ctx->queue->queuelength)--;
 
   }
 
   // release lock on queue
-  pthread_mutex_unlock(&(ctx->queue->lock));
+  unlock_queue(ctx->queue);
 
 }
 
@@ -705,12 +1862,12 @@ int local_end_of_queue(Context * ctx) {
 void local_next_element(Context * ctx) {
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue_shared(ctx->queue);
 
   local_nolock_next_element(ctx);
 
   // release lock on queue
-  pthread_mutex_unlock(&(ctx->queue->lock));
+  unlock_queue(ctx->queue);
 }
 
 
@@ -738,12 +1895,12 @@ void local_nolock_next_element(Context * ctx) {
 void local_rewind_queue(Context * ctx) {
 
   // lock entire queue
-  pthread_mutex_lock(&(ctx->queue->lock));
+  lock_queue_shared(ctx->queue);
 
   local_nolock_rewind_queue(ctx);
 
   // release lock on queue
-  pthread_mutex_unlock(&(ctx->queue->lock));
+  unlock_queue(ctx->queue);
 }
 
 void local_nolock_rewind_queue(Context * ctx) {
@@ -27,6 +27,10 @@
 //   ==>
 // (q->priority_is_tag_only || (q->queue)->priority > priority)
 //
+// Functions on two queues lock both queues in address order, with no
+// package-wide lock: they only wait for operations on the same queues.
+// They must be given two different queues, except equal_queues().
+//
 
 #include <pthread.h>
 
@@ -37,7 +41,11 @@
 #if ! defined(QUEUE_TYPE_DEFINED)
 #define QUEUE_TYPE_DEFINED
 
-// type of one element in a queue 
+// number of priorities whose last element a queue remembers
+#define QUEUE_TAIL_SLOTS 4
+
+// type of one element in a queue.  'info' points just past the node,
+// in the same allocation.
 
 typedef struct _Queue_element
 {
@@ -59,6 +67,12 @@ typedef struct Queue
   int (*compare) (void *e1, void *e2);	// element comparision function 
   pthread_mutex_t lock;
   int priority_is_tag_only;
+  struct Concurrent_queue *concurrent;	// lock-free backend, 0 for the list
+  struct Shared_list *shared;	// list shared with snapshots, 0 if private
+  struct Priority_index *index;	// last element of every priority, 0 if none
+  Queue_element tails[QUEUE_TAIL_SLOTS];	// last element of recent priorities
+  int shared_reads;		// locked with 'rwlock' instead of 'lock'?
+  pthread_rwlock_t rwlock;
 } Queue;
 
 typedef struct Context
@@ -68,6 +82,26 @@ typedef struct Context
   Queue *queue;			// queue associated with this context 
 } Context;
 
+#if defined(PRIOQUE_COUNTERS)
+
+// package-wide operation counters, compiled in with -DPRIOQUE_COUNTERS.
+// They are updated with relaxed atomic adds: totals are exact, but a
+// thread reading them while others run may see them slightly apart.
+
+typedef struct Prioque_counters
+{
+  unsigned long long add_walked;	// nodes passed to find insertion points
+  unsigned long long find_walked;	// nodes compared in element searches
+  unsigned long long mallocs;		// one per element, data included
+  unsigned long long frees;
+  unsigned long long memcpy_bytes;	// element bytes copied in and out
+  unsigned long long lock_acquisitions;	// queue locks, shared or not
+} Prioque_counters;
+
+extern Prioque_counters prioque_counters;
+
+#endif
+
 
 
 //********
@@ -104,6 +138,49 @@ void init_queue (Queue * q, int elementsize, int duplicates,
 		 int priority_is_tag_only);
 
 
+/* initializes a new concurrent queue 'q' of elements of size
+   'elementsize', backed by a lock-free skiplist instead of a locked
+   list: any number of threads can add and remove elements without
+   ever waiting for each other.  Duplicates are allowed and the queue
+   is sorted by priority, with strict add-to-rear among equal
+   priorities.  Only add_to_queue(), remove_from_front(),
+   try_remove_from_front(), empty_queue(), queue_length() and
+   destroy_queue() may be used on a concurrent queue, destroy_queue()
+   once no other thread uses it.
+
+   While elements of lower priority are being added, a remove may
+   still return an element added earlier with a higher priority: the
+   order is exact whenever adds and removes do not overlap.  An element
+   is counted by queue_length() once a remove can find it, so a single
+   consumer may call remove_from_front() after !empty_queue().
+*/
+void init_concurrent_queue (Queue * q, int elementsize);
+
+
+/* makes the read-only functions on 'q' (peek_at_current(),
+   current_priority(), local_peek_at_current(),
+   local_current_priority(), local_next_element(), local_rewind_queue()
+   and equal_queues()) hold its lock shared: they run together with
+   each other, and only wait for functions which modify 'q'.  The
+   lock prefers writers, so a function modifying 'q' only waits for
+   the readers already inside.  Call it right after init_queue(),
+   before other threads use 'q'.
+*/
+void share_reads (Queue * q);
+
+
+/* keeps an index of the last element of every priority in 'q', so
+   add_to_queue() finds where a new element goes by binary search on
+   the priorities instead of walking the list: O(log p) for p distinct
+   priorities, plus the search for duplicates if 'q' rejects them.
+   Removals update it in O(log p), or O(p) when the last element of a
+   priority goes.  The list and the global and local walks are
+   unchanged.  For queues sorted by priority ('priority_is_tag_only'
+   FALSE); destroy_queue() drops the index.
+*/
+void index_queue (Queue * q);
+
+
 /* destroys all elements in 'q'
 */
 void destroy_queue (Queue * q);
@@ -114,7 +191,10 @@ void destroy_queue (Queue * q);
    front of the queue, with strict 'to the rear' placement for items
    with equal priority [that is, given two items with equal priority,
    the one most recently added will appear closer to the rear of the
-   queue].
+   queue].  The queue remembers the last element of the priorities
+   most recently added to, one per value of the priority modulo
+   QUEUE_TAIL_SLOTS: adding behind a remembered element takes constant
+   time, other additions walk the list (or search the index).
 */
 void add_to_queue (Queue * q, void *element, int priority);
 
@@ -126,6 +206,23 @@ void add_to_queue (Queue * q, void *element, int priority);
 void remove_from_front (Queue * q, void *element);
 
 
+/* removes the element at the front of the 'q', places it in 'element'
+   and returns TRUE, or returns FALSE if the 'q' is empty.  Unlike
+   checking empty_queue() first, safe when other threads remove too.
+*/
+int try_remove_from_front (Queue * q, void *element);
+
+
+/* removes the elements at the front of the 'q' with a priority lower
+   than or equal to 'priority', up to 'max' of them, in one lock
+   acquisition, and places them in order in the 'elements' array
+   (elementsize bytes apart).  Returns the number of elements removed:
+   if it is 'max', more may be left.  Only meaningful for queues sorted
+   by priority.
+*/
+int remove_while_priority_le (Queue * q, int priority, void *elements, int max);
+
+
 /* returns TRUE if the 'element' exists in the 'q', otherwise false.
    The 'compare' function is used for matching.  As a side-effect, the
    current position in the queue is set to matching element, so
@@ -151,6 +248,18 @@ int queue_length (Queue * q);
 void copy_queue (Queue * q1, Queue * q2);
 
 
+/* makes 'q1' a snapshot of 'q2' in constant time: 'q1' shares the
+   elements of 'q2' instead of copying them, and is otherwise a queue
+   like one made with copy_queue().  A queue sharing its elements
+   copies them the first time it changes one or adds one, so the
+   changes of either queue stay invisible to the other, and removing
+   from the front copies nothing.  Positions of Contexts other than
+   the one passed to a function are lost on that copy.  'q1' and 'q2'
+   must be different; destroy_queue() releases the snapshot.
+*/
+void snapshot_queue (Queue * q1, Queue * q2);
+
+
 /* determines if 'q1' and 'q2' are equivalent.  Uses the 'compare'
    function of the first queue, which should match the 'compare' for
    the second!  Returns TRUE if the queues are equal, otherwise
@@ -159,11 +268,34 @@ void copy_queue (Queue * q1, Queue * q2);
 int equal_queues (Queue * q1, Queue * q2);
 
 
-/* merge 'q2' into 'q1'.   'q2' is not modified.
+/* merge 'q2' into 'q1'.   'q2' is not modified.  The result is the
+   same as adding every element of 'q2' in order with add_to_queue():
+   elements of 'q2' go after the elements of 'q1' with equal priority.
+   Linear in the length of both queues, unless 'q1' rejects duplicates
+   or either queue has 'priority_is_tag_only' set, where each element
+   is added in turn.
 */
 void merge_queues (Queue * q1, Queue * q2);
 
 
+/* merge 'q2' into 'q1' like merge_queues(), moving the elements of
+   'q2' instead of copying them: nothing is allocated, and 'q2' is
+   left empty.  Elements 'q1' rejects as duplicates are freed.
+*/
+void splice_queues (Queue * q1, Queue * q2);
+
+
+/* calls 'fn' with a pointer to the element at the front of the 'q',
+   its priority and 'ctx', under a single acquisition of the queue
+   lock.  'fn' may read and update the element in place, with no copy,
+   but must not change its priority, keep the pointer, or call other
+   functions on 'q'.  Returns the result of 'fn'.  'q' must not be
+   empty.
+*/
+int with_front (Queue * q, int (*fn) (void *element, int priority, void *ctx),
+		void *ctx);
+
+
 ////////////////////////////
 // SECTION 2
 ////////////////////////////
@@ -275,15 +407,24 @@ int local_end_of_queue (Context * ctx);
 // SECTION 1
 void init_queue(Queue *q, int elementsize, int duplicates, 
 		int (*compare)(void *e1, void *e2), int priority_is_tag_only);
+void init_concurrent_queue(Queue *q, int elementsize);
+void share_reads(Queue *q);
+void index_queue(Queue *q);
 void destroy_queue(Queue *q);
 void add_to_queue(Queue *q, void *element, int priority);
 void remove_from_front(Queue *q, void *element);
+int try_remove_from_front(Queue *q, void *element);
+int remove_while_priority_le(Queue *q, int priority, void *elements, int max);
 int element_in_queue(Queue *q, void *element);
 int empty_queue(Queue *q);
 int queue_length(Queue *q);
 void copy_queue(Queue *q1, Queue *q2);
+void snapshot_queue(Queue *q1, Queue *q2);
 int equal_queues(Queue q1, Queue *q2);
 void merge_queues(Queue *q1, Queue *q2);
+void splice_queues(Queue *q1, Queue *q2);
+int with_front(Queue *q, int (*fn)(void *element, int priority, void *ctx),
+               void *ctx);
 
 // SECTION 2
 
@@ -0,0 +1,548 @@
+//
+// microbenchmark of the "prioque.h" priority queue operations
+//
+// Times add_to_queue, remove_from_front, peek_at_current, update_current,
+// element_in_queue, copy_queue, snapshot_queue and merge_queues over
+// queue sizes from 10 to 10^6 elements, element sizes from 4 to 256 bytes
+// and three priority distributions, and writes the results as JSON (ns
+// per operation), so other queue implementations can be compared against
+// the same numbers.
+//
+//   $ gcc -O2 -o prioque_bench prioque.c prioque_bench.c -lpthread
+//   $ ./prioque_bench [budget_ms] [max_size] [fragmented] > results.json
+//
+// Every cell runs operations for about 'budget_ms' of measured time
+// (50 by default), at least once. Queues are rebuilt between rounds, out
+// of the measured time, whenever operations would change their size
+// too much: a round adds or removes at most 'size' elements, and merges
+// once. copy_queue, merge_queues and splice_queues are timed per call,
+// for the whole queue; merging adds min(size, 1024) elements of the same
+// distribution. snapshot_then_add times a snapshot with the copy it
+// defers to the next addition. Queues allow duplicates, so adding never
+// searches.
+//
+// "indexed_add" times add_to_queue on a queue with index_queue().
+//
+// The "typed_" operations time the same cells with "typed_prioque.h"
+// queues of a struct of the element size.
+//
+// Queues built in a fresh heap get their nodes nearly in list order,
+// which hides the cost of walking them.  With 'fragmented' set to 1,
+// every cell first fills the heap with chunks of node and element sizes
+// and frees a random half of them, so nodes land scattered as in a
+// long-running program.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "prioque.h"
+
+// typed queues of every element size: an int key and padding.
+#define TYPED_ELEMENT(bytes) \
+  typedef struct Element##bytes { int key; char padding[bytes - sizeof(int)]; } Element##bytes;
+
+static inline int same_key(const void *e1, const void *e2) {
+
+  return *(const int *)e1 == *(const int *)e2;
+}
+
+TYPED_ELEMENT(16)
+TYPED_ELEMENT(64)
+TYPED_ELEMENT(256)
+typedef struct Element4 { int key; } Element4;
+
+#define TYPED_QUEUE_NAME Typed4
+#define TYPED_QUEUE_TYPE Element4
+#define TYPED_QUEUE_EQUAL same_key
+#include "typed_prioque.h"
+#define TYPED_QUEUE_NAME Typed16
+#define TYPED_QUEUE_TYPE Element16
+#define TYPED_QUEUE_EQUAL same_key
+#include "typed_prioque.h"
+#define TYPED_QUEUE_NAME Typed64
+#define TYPED_QUEUE_TYPE Element64
+#define TYPED_QUEUE_EQUAL same_key
+#include "typed_prioque.h"
+#define TYPED_QUEUE_NAME Typed256
+#define TYPED_QUEUE_TYPE Element256
+#define TYPED_QUEUE_EQUAL same_key
+#include "typed_prioque.h"
+
+// runs 'statement' with 'Typed' and 'Element' naming the typed queue
+// and element types of the cell element size, and 'typed' its queue.
+#define WITH_TYPED(cell, statement) \
+  switch ((cell)->element_size) { \
+  case 4: { TYPED_CASE(4, cell, statement) } break; \
+  case 16: { TYPED_CASE(16, cell, statement) } break; \
+  case 64: { TYPED_CASE(64, cell, statement) } break; \
+  default: { TYPED_CASE(256, cell, statement) } break; \
+  }
+#define TYPED_CASE(bytes, cell, statement) \
+  Typed##bytes *typed = &(cell)->typed##bytes; \
+  (void)typed; \
+  statement(Typed##bytes, Element##bytes)
+
+#define MAX_ELEMENT_SIZE 256
+#define MERGE_SIZE 1024
+
+enum { UNIFORM, FEW_DISTINCT, INCREASING, DISTRIBUTIONS };
+
+static const char *distribution_names[DISTRIBUTIONS] = { "uniform", "few_distinct", "increasing" };
+static const int element_sizes[] = { 4, 16, 64, 256 };
+static const int sizes[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+
+// one benchmark cell: a queue shape and its content.
+typedef struct Cell {
+  int size;
+  int element_size;
+  int distribution;
+  int *priorities;		// sorted priorities of the queue elements
+  int next_priority;		// count of priorities drawn for added elements
+  int *merge_priorities;	// sorted priorities of the queue merged in
+  int merge_size;
+  Queue queue;
+  Queue other;			// copy destination, or the queue merged in
+  void **chunks;		// kept by fragment_heap(), 0 if not fragmented
+  int chunk_count;
+  Typed4 typed4;		// the queue as a typed queue, of the element size
+  Typed16 typed16;
+  Typed64 typed64;
+  Typed256 typed256;
+  char element[MAX_ELEMENT_SIZE];	// starts with an int key
+} Cell;
+
+static long long budget;
+static int first_result = TRUE;
+static int fragmented = FALSE;
+static unsigned long long random_state = 0x9e3779b97f4a7c15ULL;
+
+
+static unsigned int next_random(void) {
+
+  // xorshift64*, seeded: runs are reproducible
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return (unsigned int)((random_state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+
+static long long now(void) {
+
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+
+static int compare_keys(void *e1, void *e2) {
+
+  return *(int *)e1 != *(int *)e2;
+}
+
+
+static int compare_ints(const void *lhs, const void *rhs) {
+
+  int left = *(const int *)lhs, right = *(const int *)rhs;
+  return (left > right) - (left < right);
+}
+
+
+static int draw_priority(Cell *cell, int index) {
+
+  switch (cell->distribution) {
+  case UNIFORM:
+    return (int)(next_random() & 0xfffff);
+  case FEW_DISTINCT:
+    return (int)(next_random() & 3);
+  default:
+    return index;
+  }
+}
+
+
+// leaves holes of node and element sizes all over the heap for the
+// queues of the cell: allocates three chunks per element, then frees a
+// random half of them.  The other half is kept until the end of the cell.
+static void fragment_heap(Cell * cell) {
+
+  int count = 3 * cell->size;
+  unsigned long long state = 0x2545f4914f6cdd1dULL;
+  void *temp;
+
+  cell->chunks = malloc(count * sizeof(void *));
+  if(cell->chunks == 0) {
+    fprintf(stderr, "prioque_bench: out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < count; i++) {
+    cell->chunks[i] = malloc(i % 3 == 0 ? 24 : i % 3 == 1 ? cell->element_size : 32 + cell->element_size);
+    if(cell->chunks[i] == 0) {
+      fprintf(stderr, "prioque_bench: out of memory.\n");
+      exit(1);
+    }
+  }
+  for (int i = count - 1; i > 0; i--) {
+    // Fisher-Yates with a private generator, so priorities do not change
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    int j = (int)(((state * 0x2545f4914f6cdd1dULL) >> 32) % (unsigned)(i + 1));
+    temp = cell->chunks[i];
+    cell->chunks[i] = cell->chunks[j];
+    cell->chunks[j] = temp;
+  }
+  cell->chunk_count = count / 2;
+  for (int i = cell->chunk_count; i < count; i++) {
+    free(cell->chunks[i]);
+  }
+}
+
+
+// builds a queue of 'count' elements with the given sorted priorities.
+// Added from the rear priority down to a tag-only queue, every element
+// goes to the front, so building is linear; the resulting list is the
+// one adding them to a sorted queue would give.
+static void build_queue(Queue * q, Cell * cell, int *priorities, int count) {
+
+  init_queue(q, cell->element_size, TRUE, compare_keys, TRUE);
+  for (int i = count - 1; i >= 0; i--) {
+    *(int *)cell->element = i;
+    add_to_queue(q, cell->element, priorities[i]);
+  }
+  q->priority_is_tag_only = FALSE;
+}
+
+
+static void rebuild(Cell * cell) {
+
+  destroy_queue(&cell->queue);
+  build_queue(&cell->queue, cell, cell->priorities, cell->size);
+  cell->next_priority = 0;
+}
+
+
+// rebuilds the queue with a priority index.
+static void rebuild_indexed(Cell * cell) {
+
+  rebuild(cell);
+  index_queue(&cell->queue);
+}
+
+
+// rebuilds both queues, splicing empties the one merged in.
+static void rebuild_both(Cell * cell) {
+
+  rebuild(cell);
+  destroy_queue(&cell->other);
+  build_queue(&cell->other, cell, cell->merge_priorities, cell->merge_size);
+}
+
+
+// builds the typed queue of the cell: priorities are sorted, so every
+// element is appended.
+#define BUILD_TYPED(Typed, Element) \
+  Typed##_destroy(typed); \
+  Typed##_init(typed, TRUE); \
+  for (int i = 0; i < cell->size; i++) { \
+    Element *element = Typed##_emplace(typed, cell->priorities[i]); \
+    memset(element, 0, sizeof(Element)); \
+    element->key = i; \
+  }
+
+static void rebuild_typed(Cell * cell) {
+
+  WITH_TYPED(cell, BUILD_TYPED);
+  cell->next_priority = 0;
+}
+
+
+// operations: 'i' counts the calls of the round.
+
+static void op_add(Cell * cell, long long i) {
+
+  *(int *)cell->element = cell->size + (int)i;
+  add_to_queue(&cell->queue, cell->element,
+	       draw_priority(cell, cell->size + cell->next_priority++));
+}
+
+
+static void op_remove(Cell * cell, long long i) {
+
+  (void)i;
+  remove_from_front(&cell->queue, cell->element);
+}
+
+
+static void op_peek(Cell * cell, long long i) {
+
+  (void)i;
+  peek_at_current(&cell->queue, cell->element);
+}
+
+
+static void op_update(Cell * cell, long long i) {
+
+  (void)i;
+  update_current(&cell->queue, cell->element);
+}
+
+
+static void op_find(Cell * cell, long long i) {
+
+  (void)i;
+  *(int *)cell->element = (int)(next_random() % (unsigned int)cell->size);
+  if(!element_in_queue(&cell->queue, cell->element)) {
+    fprintf(stderr, "prioque_bench: element %d not found.\n", *(int *)cell->element);
+    exit(1);
+  }
+}
+
+
+static void op_copy(Cell * cell, long long i) {
+
+  (void)i;
+  copy_queue(&cell->other, &cell->queue);
+}
+
+
+static void op_snapshot(Cell * cell, long long i) {
+
+  (void)i;
+  snapshot_queue(&cell->other, &cell->queue);
+}
+
+
+// a snapshot, then the copy it defers to the next addition.
+static void op_snapshot_add(Cell * cell, long long i) {
+
+  snapshot_queue(&cell->other, &cell->queue);
+  op_add(cell, i);
+}
+
+
+static void op_merge(Cell * cell, long long i) {
+
+  (void)i;
+  merge_queues(&cell->queue, &cell->other);
+}
+
+
+static void op_splice(Cell * cell, long long i) {
+
+  (void)i;
+  splice_queues(&cell->queue, &cell->other);
+}
+
+
+// the same operations on the typed queue.
+
+#define TYPED_ADD(Typed, Element) \
+  Element element; \
+  memcpy(&element, cell->element, sizeof(Element)); \
+  element.key = cell->size + (int)i; \
+  Typed##_add(typed, &element, draw_priority(cell, cell->size + cell->next_priority++));
+
+static void op_typed_add(Cell * cell, long long i) {
+
+  WITH_TYPED(cell, TYPED_ADD);
+}
+
+
+#define TYPED_REMOVE(Typed, Element) \
+  Typed##_remove_front(typed, (Element *)cell->element);
+
+static void op_typed_remove(Cell * cell, long long i) {
+
+  (void)i;
+  WITH_TYPED(cell, TYPED_REMOVE);
+}
+
+
+#define TYPED_PEEK(Typed, Element) \
+  *(Element *)cell->element = *Typed##_front(typed);
+
+static void op_typed_peek(Cell * cell, long long i) {
+
+  (void)i;
+  WITH_TYPED(cell, TYPED_PEEK);
+}
+
+
+#define TYPED_UPDATE(Typed, Element) \
+  Typed##_front(typed)->key++;
+
+static void op_typed_update(Cell * cell, long long i) {
+
+  (void)i;
+  WITH_TYPED(cell, TYPED_UPDATE);
+}
+
+
+#define TYPED_FIND(Typed, Element) \
+  if(Typed##_find(typed, (Element *)cell->element) == 0) { \
+    fprintf(stderr, "prioque_bench: element %d not found.\n", *(int *)cell->element); \
+    exit(1); \
+  }
+
+static void op_typed_find(Cell * cell, long long i) {
+
+  (void)i;
+  *(int *)cell->element = (int)(next_random() % (unsigned int)cell->size);
+  WITH_TYPED(cell, TYPED_FIND);
+}
+
+
+typedef struct Operation {
+  const char *name;
+  void (*run) (Cell * cell, long long i);
+  int round_limit;		// calls per round before a rebuild, 0 if unlimited, -1 for 'size'
+  void (*rebuild) (Cell * cell);
+} Operation;
+
+static const Operation operations[] = {
+  {"add_to_queue", op_add, -1, rebuild},
+  {"indexed_add", op_add, -1, rebuild_indexed},
+  {"remove_from_front", op_remove, -1, rebuild},
+  {"peek_at_current", op_peek, 0, rebuild},
+  {"update_current", op_update, 0, rebuild},
+  {"element_in_queue", op_find, 0, rebuild},
+  {"copy_queue", op_copy, 0, rebuild},
+  {"snapshot_queue", op_snapshot, 0, rebuild},
+  {"snapshot_then_add", op_snapshot_add, -1, rebuild},
+  {"merge_queues", op_merge, 1, rebuild},
+  {"splice_queues", op_splice, 1, rebuild_both},
+  {"typed_add", op_typed_add, -1, rebuild_typed},
+  {"typed_remove_front", op_typed_remove, -1, rebuild_typed},
+  {"typed_front", op_typed_peek, 0, rebuild_typed},
+  {"typed_update_front", op_typed_update, 0, rebuild_typed},
+  {"typed_find", op_typed_find, 0, rebuild_typed},
+};
+
+
+// runs an operation in doubling batches until the budget is spent.
+static void measure(Cell * cell, const Operation * operation) {
+
+  long long elapsed = 0, calls = 0;
+  long long limit = operation->round_limit < 0 ? cell->size : operation->round_limit;
+
+  while (calls == 0 || elapsed < budget) {
+    long long round = 0, batch = 1;
+
+    operation->rebuild(cell);
+    while (elapsed < budget && (limit == 0 || round < limit)) {
+      long long start;
+
+      if(limit > 0 && round + batch > limit) {
+	batch = limit - round;
+      }
+      start = now();
+      for (long long i = 0; i < batch; i++) {
+	operation->run(cell, round + i);
+      }
+      elapsed += now() - start;
+      round += batch;
+      batch *= 2;
+    }
+    calls += round;
+  }
+
+  printf("%s\n    {\"operation\": \"%s\", \"size\": %d, \"element_size\": %d, "
+	 "\"distribution\": \"%s\", \"calls\": %lld, \"ns_per_op\": %.1f}",
+	 first_result ? "" : ",", operation->name, cell->size, cell->element_size,
+	 distribution_names[cell->distribution], calls, (double)elapsed / calls);
+  fflush(stdout);
+  first_result = FALSE;
+}
+
+
+static void run_cell(int size, int element_size, int distribution) {
+
+  Cell cell;
+  int merge_size = size < MERGE_SIZE ? size : MERGE_SIZE;
+  int *merge_priorities;
+
+  memset(&cell, 0, sizeof(cell));
+  cell.size = size;
+  cell.element_size = element_size;
+  cell.distribution = distribution;
+  cell.priorities = malloc(size * sizeof(int));
+  cell.merge_priorities = merge_priorities = malloc(merge_size * sizeof(int));
+  cell.merge_size = merge_size;
+  if(cell.priorities == 0 || merge_priorities == 0) {
+    fprintf(stderr, "prioque_bench: out of memory.\n");
+    exit(1);
+  }
+
+  for (int i = 0; i < size; i++) {
+    cell.priorities[i] = draw_priority(&cell, i);
+  }
+  qsort(cell.priorities, size, sizeof(int), compare_ints);
+  for (int i = 0; i < merge_size; i++) {
+    merge_priorities[i] = draw_priority(&cell, i);
+  }
+  qsort(merge_priorities, merge_size, sizeof(int), compare_ints);
+
+  if(fragmented) {
+    fragment_heap(&cell);
+  }
+  init_queue(&cell.queue, element_size, TRUE, compare_keys, FALSE);
+  Typed4_init(&cell.typed4, TRUE);
+  Typed16_init(&cell.typed16, TRUE);
+  Typed64_init(&cell.typed64, TRUE);
+  Typed256_init(&cell.typed256, TRUE);
+  for (size_t op = 0; op < sizeof(operations) / sizeof(operations[0]); op++) {
+    if(operations[op].run == op_merge || operations[op].run == op_splice) {
+      build_queue(&cell.other, &cell, merge_priorities, merge_size);
+    }
+    else {
+      init_queue(&cell.other, element_size, TRUE, compare_keys, FALSE);
+    }
+    measure(&cell, &operations[op]);
+    destroy_queue(&cell.other);
+  }
+
+  destroy_queue(&cell.queue);
+  Typed4_destroy(&cell.typed4);
+  Typed16_destroy(&cell.typed16);
+  Typed64_destroy(&cell.typed64);
+  Typed256_destroy(&cell.typed256);
+  free(merge_priorities);
+  free(cell.priorities);
+  for (int i = 0; i < cell.chunk_count; i++) {
+    free(cell.chunks[i]);
+  }
+  free(cell.chunks);
+}
+
+
+int main(int argc, char *argv[]) {
+
+  int max_size = 1000000;
+
+  budget = (argc > 1 ? atoll(argv[1]) : 50) * 1000000LL;
+  if(argc > 2) {
+    max_size = atoi(argv[2]);
+  }
+  if(argc > 3) {
+    fragmented = atoi(argv[3]) != 0;
+  }
+  if(budget <= 0 || max_size <= 0) {
+    fprintf(stderr, "usage: %s [budget_ms] [max_size] [fragmented]\n", argv[0]);
+    return 1;
+  }
+
+  printf("{\n  \"benchmark\": \"prioque\",\n  \"budget_ms\": %lld,\n  \"fragmented\": %s,\n"
+	 "  \"results\": [", budget / 1000000, fragmented ? "true" : "false");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max_size; s++) {
+    for (size_t e = 0; e < sizeof(element_sizes) / sizeof(element_sizes[0]); e++) {
+      for (int d = 0; d < DISTRIBUTIONS; d++) {
+	run_cell(sizes[s], element_sizes[e], d);
+      }
+    }
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
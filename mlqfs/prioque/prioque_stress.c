@@ -0,0 +1,491 @@
+//
+// multi-threaded stress benchmark of the "prioque.h" locking
+//
+// Every thread owns a pair of queues and runs a mix of single-queue
+// operations (add_to_queue, remove_from_front, peek_at_current) and
+// two-queue operations (copy_queue, equal_queues, merge_queues) on its
+// own pair for a fixed time.  The pairs are disjoint, so with enough
+// cores the throughput should grow with the number of threads: any
+// flattening comes from locking shared by unrelated queues.  Prints the
+// throughput for 1 to 64 threads as JSON.
+//
+// A second series has all threads share one queue, half adding and half
+// removing with try_remove_from_front(), once with a locked queue and
+// once with a lock-free one from init_concurrent_queue().  It starts
+// with SHARED_LENGTH elements and keeps about that many.
+//
+// A third series has one thread add to and remove from the shared queue
+// while the others observe it with equal_queues(), a read-only walk of
+// the whole queue, with and without share_reads().
+//
+// With 'verify' set to 1, the lock-free queue is checked instead of
+// timed: a random sequence of adds and removes must give the same
+// elements as a locked queue, and elements added by concurrent
+// producers must each be removed once by the consumers, for 2 to
+// 'max_threads' threads.  One consumer alone removes with
+// remove_from_front() after !empty_queue().  Exits with 1 on a failure.
+//
+//   $ gcc -O2 -o prioque_stress prioque.c prioque_stress.c -lpthread
+//   $ ./prioque_stress [duration_ms] [max_threads] [verify] > results.json
+//
+// The queues hold up to 64 ints; a quarter of the operations take two
+// queues.  Threads start together on a condition variable and stop on a
+// shared flag, operations are counted per thread.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "prioque.h"
+
+#define MAX_LENGTH 64
+#define MAX_THREADS 64
+#define SHARED_LENGTH 1024
+#define VERIFY_OPERATIONS 200000	// of the sequential check
+#define VERIFY_ADDS 50000		// by each producer of the concurrent check
+
+// one thread and its queue pair, on cache lines of its own.
+typedef struct Worker {
+  pthread_t thread;
+  Queue a;
+  Queue b;			// copy of 'a', then 'a' merged into it
+  int index;			// 0 for the first thread
+  unsigned long long random_state;
+  unsigned long long operations;
+  char padding[64];
+} Worker;
+
+static Queue shared;		// the queue of the shared series
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_signal = PTHREAD_COND_INITIALIZER;
+static int started = FALSE;
+static int stopped = FALSE;
+static unsigned long long first_operations;	// of thread 0 in the last run
+static int producing;		// producers still adding, when verifying
+static int single_consumer;	// the only consumer checks empty_queue() first
+static unsigned char *removed;	// removals of every element, when verifying
+
+
+static long long now(void) {
+
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+
+static unsigned int next_random(Worker * worker) {
+
+  // xorshift64*, seeded per thread
+  worker->random_state ^= worker->random_state >> 12;
+  worker->random_state ^= worker->random_state << 25;
+  worker->random_state ^= worker->random_state >> 27;
+  return (unsigned int)((worker->random_state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+
+static int compare_ints(void *e1, void *e2) {
+
+  return *(int *)e1 != *(int *)e2;
+}
+
+
+// one operation of the mix, chosen by the operation count.
+static void operate(Worker * worker, unsigned long long i) {
+
+  int element;
+
+  switch (i % 16) {
+  case 0: case 1: case 2: case 8: case 9: case 10:
+    if(queue_length(&worker->a) < MAX_LENGTH) {
+      element = (int)next_random(worker);
+      add_to_queue(&worker->a, &element, element & 0xff);
+    }
+    else {
+      remove_from_front(&worker->a, &element);
+    }
+    break;
+  case 3: case 4: case 11: case 12:
+    if(!empty_queue(&worker->a)) {
+      remove_from_front(&worker->a, &element);
+    }
+    break;
+  case 5: case 13:
+    if(!empty_queue(&worker->a)) {
+      rewind_queue(&worker->a);
+      peek_at_current(&worker->a, &element);
+    }
+    break;
+  case 6: case 14:
+    copy_queue(&worker->b, &worker->a);
+    break;
+  case 7:
+    if(!equal_queues(&worker->a, &worker->b)) {
+      fprintf(stderr, "prioque_stress: copy differs from its queue.\n");
+      exit(1);
+    }
+    break;
+  default:
+    merge_queues(&worker->b, &worker->a);
+    break;
+  }
+}
+
+
+// one operation on the shared queue: adds and removes alternate.
+static void operate_shared(Worker * worker, unsigned long long i) {
+
+  int element;
+
+  if(i % 2 == 0) {
+    element = (int)next_random(worker);
+    add_to_queue(&shared, &element, element & 0xff);
+  }
+  else {
+    try_remove_from_front(&shared, &element);
+  }
+}
+
+
+static void wait_for_start(void) {
+
+  pthread_mutex_lock(&start_lock);
+  while (!started) {
+    pthread_cond_wait(&start_signal, &start_lock);
+  }
+  pthread_mutex_unlock(&start_lock);
+}
+
+
+static void *run_worker(void *argument) {
+
+  Worker *worker = argument;
+  unsigned long long i = 0;
+
+  wait_for_start();
+  while (!__atomic_load_n(&stopped, __ATOMIC_RELAXED)) {
+    operate(worker, i++);
+  }
+  worker->operations = i;
+  return 0;
+}
+
+
+static void *run_shared_worker(void *argument) {
+
+  Worker *worker = argument;
+  unsigned long long i = 0;
+
+  wait_for_start();
+  while (!__atomic_load_n(&stopped, __ATOMIC_RELAXED)) {
+    operate_shared(worker, i++);
+  }
+  worker->operations = i;
+  return 0;
+}
+
+
+// thread 0 modifies the shared queue, the others only read it.
+static void *run_observed_worker(void *argument) {
+
+  Worker *worker = argument;
+  unsigned long long i = 0;
+
+  wait_for_start();
+  while (!__atomic_load_n(&stopped, __ATOMIC_RELAXED)) {
+    if(worker->index == 0) {
+      operate_shared(worker, i++);
+    }
+    else {
+      equal_queues(&shared, &shared);
+      i++;
+    }
+  }
+  worker->operations = i;
+  return 0;
+}
+
+
+static void fill_shared(void) {
+
+  for (int i = 0; i < SHARED_LENGTH; i++) {
+    int element = i * 7919;
+    add_to_queue(&shared, &element, element & 0xff);
+  }
+}
+
+
+static void fail(const char *message, int element) {
+
+  fprintf(stderr, "prioque_stress: %s (element %d).\n", message, element);
+  exit(1);
+}
+
+
+// the lock-free queue against a locked one, on one thread, with up to
+// SHARED_LENGTH elements.
+static void verify_sequential(void) {
+
+  Queue concurrent, list;
+  Worker worker;
+  int element, expected, priority;
+
+  worker.random_state = 0x9e3779b97f4a7c15ULL;
+  init_concurrent_queue(&concurrent, sizeof(int));
+  init_queue(&list, sizeof(int), TRUE, compare_ints, FALSE);
+  for (int i = 0; i < VERIFY_OPERATIONS; i++) {
+    if(queue_length(&list) < SHARED_LENGTH && next_random(&worker) % 2 == 0) {
+      priority = next_random(&worker) & 0x3f;
+      add_to_queue(&concurrent, &i, priority);
+      add_to_queue(&list, &i, priority);
+    }
+    else if(!empty_queue(&list)) {
+      remove_from_front(&list, &expected);
+      if(!try_remove_from_front(&concurrent, &element) || element != expected) {
+	fail("lock-free queue differs from the list", expected);
+      }
+    }
+    if(queue_length(&concurrent) != queue_length(&list)) {
+      fail("lock-free queue length differs from the list", i);
+    }
+  }
+  while (try_remove_from_front(&list, &expected)) {
+    if(!try_remove_from_front(&concurrent, &element) || element != expected) {
+      fail("lock-free queue differs from the list", expected);
+    }
+  }
+  if(!empty_queue(&concurrent)) {
+    fail("lock-free queue not empty", -1);
+  }
+  destroy_queue(&concurrent);
+  destroy_queue(&list);
+}
+
+
+static void *run_producer(void *argument) {
+
+  Worker *worker = argument;
+
+  for (int i = 0; i < VERIFY_ADDS; i++) {
+    int element = worker->index * VERIFY_ADDS + i;
+    add_to_queue(&shared, &element, next_random(worker) & 0xff);
+  }
+  __atomic_fetch_sub(&producing, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+
+static void *run_consumer(void *argument) {
+
+  Worker *worker = argument;
+  int element, taken, done;
+
+  for (;;) {
+    done = __atomic_load_n(&producing, __ATOMIC_ACQUIRE) == 0;
+    if(single_consumer) {
+      // remove_from_front() asserts if the counted element is not found
+      taken = !empty_queue(&shared);
+      if(taken) {
+	remove_from_front(&shared, &element);
+      }
+    }
+    else {
+      taken = try_remove_from_front(&shared, &element);
+    }
+    if(taken) {
+      if(__atomic_exchange_n(&removed[element], 1, __ATOMIC_RELAXED)) {
+	fail("element removed twice", element);
+      }
+      worker->operations++;
+    }
+    else if(done) {
+      return 0;
+    }
+  }
+}
+
+
+// 'producers' threads add VERIFY_ADDS elements each to the lock-free
+// queue while 'consumers' threads empty it; every element must come out
+// once.  Returns the number of elements removed.
+static unsigned long long verify_concurrent(int producers, int consumers) {
+
+  Worker *workers[MAX_THREADS];
+  int threads = producers + consumers;
+  unsigned long long total = 0;
+
+  init_concurrent_queue(&shared, sizeof(int));
+  removed = calloc((size_t)producers * VERIFY_ADDS, 1);
+  if(removed == 0) {
+    fprintf(stderr, "prioque_stress: out of memory.\n");
+    exit(1);
+  }
+  producing = producers;
+  single_consumer = consumers == 1;
+  for (int t = 0; t < threads; t++) {
+    if(posix_memalign((void **)&workers[t], 64, sizeof(Worker)) != 0) {
+      fprintf(stderr, "prioque_stress: out of memory.\n");
+      exit(1);
+    }
+    memset(workers[t], 0, sizeof(Worker));
+    workers[t]->index = t;
+    workers[t]->random_state = 0x9e3779b97f4a7c15ULL * (t + 1);
+    if(pthread_create(&workers[t]->thread, 0, t < producers ? run_producer : run_consumer,
+		      workers[t]) != 0) {
+      fprintf(stderr, "prioque_stress: cannot create thread %d.\n", t);
+      exit(1);
+    }
+  }
+  for (int t = 0; t < threads; t++) {
+    pthread_join(workers[t]->thread, 0);
+    total += workers[t]->operations;
+    free(workers[t]);
+  }
+  for (int i = 0; i < producers * VERIFY_ADDS; i++) {
+    if(!removed[i]) {
+      fail("element lost", i);
+    }
+  }
+  if(!empty_queue(&shared) || queue_length(&shared) != 0) {
+    fail("lock-free queue not empty", -1);
+  }
+  destroy_queue(&shared);
+  free(removed);
+  return total;
+}
+
+
+// runs 'threads' workers for 'duration' ns, returns the operations per second.
+static double run(int threads, long long duration, unsigned long long *total,
+		  void *(*body) (void *)) {
+
+  Worker *workers[MAX_THREADS];
+  long long start, elapsed;
+  struct timespec delay = { duration / 1000000000LL, duration % 1000000000LL };
+
+  started = FALSE;
+  stopped = FALSE;
+  for (int t = 0; t < threads; t++) {
+    // each worker is aligned on its own cache lines
+    if(posix_memalign((void **)&workers[t], 64, sizeof(Worker)) != 0) {
+      fprintf(stderr, "prioque_stress: out of memory.\n");
+      exit(1);
+    }
+    memset(workers[t], 0, sizeof(Worker));
+    init_queue(&workers[t]->a, sizeof(int), TRUE, compare_ints, FALSE);
+    init_queue(&workers[t]->b, sizeof(int), TRUE, compare_ints, FALSE);
+    workers[t]->index = t;
+    workers[t]->random_state = 0x9e3779b97f4a7c15ULL * (t + 1);
+    if(pthread_create(&workers[t]->thread, 0, body, workers[t]) != 0) {
+      fprintf(stderr, "prioque_stress: cannot create thread %d.\n", t);
+      exit(1);
+    }
+  }
+
+  pthread_mutex_lock(&start_lock);
+  started = TRUE;
+  start = now();
+  pthread_cond_broadcast(&start_signal);
+  pthread_mutex_unlock(&start_lock);
+
+  while (nanosleep(&delay, &delay) != 0) {
+  }
+  __atomic_store_n(&stopped, TRUE, __ATOMIC_RELAXED);
+
+  *total = 0;
+  for (int t = 0; t < threads; t++) {
+    pthread_join(workers[t]->thread, 0);
+    *total += workers[t]->operations;
+    if(t == 0) {
+      first_operations = workers[t]->operations;
+    }
+    destroy_queue(&workers[t]->a);
+    destroy_queue(&workers[t]->b);
+    free(workers[t]);
+  }
+  elapsed = now() - start;
+
+  return *total / (elapsed / 1e9);
+}
+
+
+int main(int argc, char *argv[]) {
+
+  long long duration = (argc > 1 ? atoll(argv[1]) : 500) * 1000000LL;
+  int max_threads = argc > 2 ? atoi(argv[2]) : MAX_THREADS;
+  int verify = argc > 3 ? atoi(argv[3]) : FALSE;
+  unsigned long long total;
+  double rate, single = 0, locked, lock_free, writer;
+
+  if(duration <= 0 || max_threads < 1 || max_threads > MAX_THREADS) {
+    fprintf(stderr, "usage: %s [duration_ms] [max_threads <= %d] [verify]\n", argv[0],
+	    MAX_THREADS);
+    return 1;
+  }
+
+  if(verify) {
+    verify_sequential();
+    printf("{\n  \"benchmark\": \"prioque_stress\",\n  \"sequential_operations\": %d,\n"
+	   "  \"verified\": [", VERIFY_OPERATIONS);
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+      // one consumer, then as many consumers as producers
+      for (int consumers = 1; consumers <= threads / 2; consumers += threads / 2 - 1) {
+	total = verify_concurrent(threads - consumers, consumers);
+	printf("%s\n    {\"producers\": %d, \"consumers\": %d, \"removed\": %llu}",
+	       threads == 2 ? "" : ",", threads - consumers, consumers, total);
+	fflush(stdout);
+	if(threads == 2) {
+	  break;
+	}
+      }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+  }
+
+  printf("{\n  \"benchmark\": \"prioque_stress\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+	 duration / 1000000);
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    rate = run(threads, duration, &total, run_worker);
+    if(threads == 1) {
+      single = rate;
+    }
+    printf("%s\n    {\"threads\": %d, \"operations\": %llu, \"ops_per_sec\": %.0f, "
+	   "\"speedup\": %.2f}", threads == 1 ? "" : ",", threads, total, rate, rate / single);
+    fflush(stdout);
+  }
+  printf("\n  ],\n  \"shared\": [");
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    init_queue(&shared, sizeof(int), TRUE, compare_ints, FALSE);
+    fill_shared();
+    locked = run(threads, duration, &total, run_shared_worker);
+    destroy_queue(&shared);
+    init_concurrent_queue(&shared, sizeof(int));
+    fill_shared();
+    lock_free = run(threads, duration, &total, run_shared_worker);
+    destroy_queue(&shared);
+    printf("%s\n    {\"threads\": %d, \"locked_ops_per_sec\": %.0f, "
+	   "\"lock_free_ops_per_sec\": %.0f}", threads == 1 ? "" : ",", threads, locked, lock_free);
+    fflush(stdout);
+  }
+  printf("\n  ],\n  \"observed\": [");
+  for (int threads = 2; threads <= max_threads; threads *= 2) {
+    for (int shared_reads = FALSE; shared_reads <= TRUE; shared_reads++) {
+      init_queue(&shared, sizeof(int), TRUE, compare_ints, FALSE);
+      if(shared_reads) {
+	share_reads(&shared);
+      }
+      fill_shared();
+      rate = run(threads, duration, &total, run_observed_worker);
+      destroy_queue(&shared);
+      writer = total > 0 ? rate * first_operations / total : 0;
+      printf("%s\n    {\"threads\": %d, \"shared_reads\": %s, \"writer_ops_per_sec\": %.0f, "
+	     "\"reader_ops_per_sec\": %.0f}", threads == 2 && !shared_reads ? "" : ",", threads,
+	     shared_reads ? "true" : "false", writer, rate - writer);
+      fflush(stdout);
+    }
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
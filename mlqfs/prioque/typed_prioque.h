@@ -0,0 +1,343 @@
+//
+// typed priority queue template "typed_prioque.h"
+//
+// A header-only variant of "prioque.h" for one element type known at
+// compile time.  Elements live inside their list node (one malloc per
+// element instead of two), are assigned instead of memcpy'd with a
+// run-time size, and the element comparison is a compile-time function
+// the compiler can inline.  Semantics match "prioque.h": lower priorities
+// first, strict add-to-rear among equal priorities, optional silent
+// rejection of duplicates, and local walks with a context.
+//
+// Unlike "prioque.h", these queues are not locked: a queue shared by
+// threads must be protected by its users.  They are meant for queues
+// owned by one thread, such as the scheduler queues of mlqfs.
+//
+// The header is a template: define the parameters, then include it, as
+// many times as there are element types.
+//
+//   #define TYPED_QUEUE_NAME  ProcessQueue	 // prefix of the generated names
+//   #define TYPED_QUEUE_TYPE  Process		 // element type
+//   #define TYPED_QUEUE_EQUAL same_process	 // optional, see below
+//   #include "typed_prioque.h"
+//
+// generates:
+//
+//   typedef struct { ... } ProcessQueue;
+//   typedef struct { ... } ProcessQueue_context;
+//
+//   void ProcessQueue_init(ProcessQueue *q, int duplicates);
+//   void ProcessQueue_destroy(ProcessQueue *q);
+//   int ProcessQueue_add(ProcessQueue *q, const Process *element, int priority);
+//   Process *ProcessQueue_emplace(ProcessQueue *q, int priority);
+//   Process *ProcessQueue_front(ProcessQueue *q);
+//   int ProcessQueue_front_priority(ProcessQueue *q);
+//   void ProcessQueue_remove_front(ProcessQueue *q, Process *element);
+//   Process *ProcessQueue_find(ProcessQueue *q, const Process *element);
+//   int ProcessQueue_length(ProcessQueue *q);
+//   int ProcessQueue_empty(ProcessQueue *q);
+//
+//   void ProcessQueue_init_context(ProcessQueue *q, ProcessQueue_context *ctx);
+//   void ProcessQueue_rewind(ProcessQueue_context *ctx);
+//   void ProcessQueue_next(ProcessQueue_context *ctx);
+//   int ProcessQueue_end(ProcessQueue_context *ctx);
+//   Process *ProcessQueue_current(ProcessQueue_context *ctx);
+//   int ProcessQueue_current_priority(ProcessQueue_context *ctx);
+//   void ProcessQueue_delete_current(ProcessQueue_context *ctx);
+//
+// TYPED_QUEUE_EQUAL names a function or macro 'int equal(const T *e1,
+// const T *e2)' returning non-0 when two elements match, like the
+// 'compare' function of "prioque.h" with the opposite result.  It is
+// required for queues rejecting duplicates and for _find().
+//
+// Pointers returned by _front(), _emplace(), _find() and _current() stay
+// valid until their element is removed: the element can be read and
+// updated in place, but its priority must not change.
+//
+
+#include <stdlib.h>
+#include <assert.h>
+
+#if ! defined(TRUE)
+#define  TRUE  1
+#define  FALSE 0
+#endif
+
+#if ! defined(TYPED_QUEUE_NAME) || ! defined(TYPED_QUEUE_TYPE)
+#error "define TYPED_QUEUE_NAME and TYPED_QUEUE_TYPE before including typed_prioque.h"
+#endif
+
+#define TYPED_QUEUE_CONCAT_(name, suffix) name##_##suffix
+#define TYPED_QUEUE_CONCAT(name, suffix) TYPED_QUEUE_CONCAT_(name, suffix)
+#define TQ(suffix) TYPED_QUEUE_CONCAT(TYPED_QUEUE_NAME, suffix)
+
+// type of one element in a queue, with the data inline
+
+typedef struct TQ(element)
+{
+  struct TQ(element) *next;
+  int priority;
+  TYPED_QUEUE_TYPE info;
+} TQ(element);
+
+// basic queue type
+
+typedef struct TYPED_QUEUE_NAME
+{
+  TQ(element) *queue;		// linked list of elements
+  TQ(element) *tail;		// last element, for appending in O(1)
+  int queuelength;		// # of elements in queue
+  int duplicates;		// are duplicates allowed?
+} TYPED_QUEUE_NAME;
+
+typedef struct TQ(context)
+{
+  TQ(element) *current;		// current position for local seq access functions
+  TQ(element) *previous;	// one step back from current
+  TYPED_QUEUE_NAME *queue;	// queue associated with this context
+} TQ(context);
+
+
+/* initializes a new, empty queue 'q'.  If 'duplicates' is false,
+   adding an element equal to one in the queue has no effect.
+*/
+static inline void TQ(init) (TYPED_QUEUE_NAME * q, int duplicates) {
+
+#if ! defined(TYPED_QUEUE_EQUAL)
+  assert(duplicates && "rejecting duplicates requires TYPED_QUEUE_EQUAL");
+#endif
+  q->queue = 0;
+  q->tail = 0;
+  q->queuelength = 0;
+  q->duplicates = duplicates;
+}
+
+
+/* destroys all elements in 'q'
+*/
+static inline void TQ(destroy) (TYPED_QUEUE_NAME * q) {
+
+  TQ(element) * temp;
+
+  while (q->queue != 0) {
+    temp = q->queue;
+    q->queue = q->queue->next;
+    free(temp);
+  }
+  q->tail = 0;
+  q->queuelength = 0;
+}
+
+
+#if defined(TYPED_QUEUE_EQUAL)
+/* returns a pointer to the first element of 'q' equal to 'element', or
+   0 if there is none.
+*/
+static inline TYPED_QUEUE_TYPE *TQ(find) (TYPED_QUEUE_NAME * q,
+					   const TYPED_QUEUE_TYPE * element) {
+
+  for (TQ(element) * ptr = q->queue; ptr != 0; ptr = ptr->next) {
+    if(TYPED_QUEUE_EQUAL(element, &ptr->info)) {
+      return &ptr->info;
+    }
+  }
+  return 0;
+}
+#endif
+
+
+// links a new node with 'priority' at its place: after the last
+// element of lower or equal priority, so equal priorities stay in
+// order of addition.
+static inline TYPED_QUEUE_TYPE *TQ(link) (TYPED_QUEUE_NAME * q, int priority) {
+
+  TQ(element) * new_element, *ptr, *prev = 0;
+
+  new_element = (TQ(element) *) malloc(sizeof(TQ(element)));
+  if(new_element == 0) {
+    assert(!"Malloc failed in function add_to_queue()\n");
+    exit(1);
+  }
+  new_element->priority = priority;
+  (q->queuelength)++;
+
+  if(q->queue == 0) {
+    new_element->next = 0;
+    q->queue = q->tail = new_element;
+  }
+  else if(q->tail->priority <= priority) {
+    new_element->next = 0;
+    q->tail->next = new_element;
+    q->tail = new_element;
+  }
+  else if(q->queue->priority > priority) {
+    new_element->next = q->queue;
+    q->queue = new_element;
+  }
+  else {
+    ptr = q->queue;
+    while (ptr != 0 && priority >= ptr->priority) {
+      prev = ptr;
+      ptr = ptr->next;
+    }
+    new_element->next = prev->next;
+    prev->next = new_element;
+  }
+
+  return &new_element->info;
+}
+
+
+/* adds a copy of 'element' to 'q' with position based on 'priority',
+   like add_to_queue().  Returns TRUE if the element was added, FALSE
+   if it was a rejected duplicate.
+*/
+static inline int TQ(add) (TYPED_QUEUE_NAME * q,
+			   const TYPED_QUEUE_TYPE * element, int priority) {
+
+#if defined(TYPED_QUEUE_EQUAL)
+  if(!q->duplicates && TQ(find) (q, element) != 0) {
+    return FALSE;
+  }
+#endif
+  *TQ(link) (q, priority) = *element;
+  return TRUE;
+}
+
+
+/* adds an element with 'priority' and returns a pointer to it, for the
+   caller to build it in place.  Its content is undefined until then.
+   Only for queues allowing duplicates, which need no comparison first.
+*/
+static inline TYPED_QUEUE_TYPE *TQ(emplace) (TYPED_QUEUE_NAME * q, int priority) {
+
+  assert(q->duplicates && "emplace requires a queue allowing duplicates");
+  return TQ(link) (q, priority);
+}
+
+
+/* returns a pointer to the element at the front of 'q', 0 if 'q' is empty.
+*/
+static inline TYPED_QUEUE_TYPE *TQ(front) (TYPED_QUEUE_NAME * q) {
+
+  return q->queue != 0 ? &q->queue->info : 0;
+}
+
+
+/* returns the priority of the element at the front of 'q', which must
+   not be empty.
+*/
+static inline int TQ(front_priority) (TYPED_QUEUE_NAME * q) {
+
+  assert(q->queue != 0 && "NULL pointer in function front_priority()");
+  return q->queue->priority;
+}
+
+
+/* removes the element at the front of the 'q' and places it in
+   'element', unless 'element' is 0.
+*/
+static inline void TQ(remove_front) (TYPED_QUEUE_NAME * q, TYPED_QUEUE_TYPE * element) {
+
+  TQ(element) * temp = q->queue;
+
+  assert(temp != 0 && "NULL pointer in function remove_from_front()");
+  if(element != 0) {
+    *element = temp->info;
+  }
+  q->queue = temp->next;
+  if(q->queue == 0) {
+    q->tail = 0;
+  }
+  free(temp);
+  (q->queuelength)--;
+}
+
+
+static inline int TQ(length) (TYPED_QUEUE_NAME * q) {
+
+  return q->queuelength;
+}
+
+
+static inline int TQ(empty) (TYPED_QUEUE_NAME * q) {
+
+  return q->queue == 0;
+}
+
+
+// local walks, as in SECTION 3 of "prioque.h"
+
+static inline void TQ(init_context) (TYPED_QUEUE_NAME * q, TQ(context) * ctx) {
+
+  ctx->queue = q;
+  ctx->current = q->queue;
+  ctx->previous = 0;
+}
+
+
+static inline void TQ(rewind) (TQ(context) * ctx) {
+
+  ctx->current = ctx->queue->queue;
+  ctx->previous = 0;
+}
+
+
+static inline void TQ(next) (TQ(context) * ctx) {
+
+  assert(ctx->current != 0 && "Advance past end in function next_element()");
+  ctx->previous = ctx->current;
+  ctx->current = ctx->current->next;
+}
+
+
+static inline int TQ(end) (TQ(context) * ctx) {
+
+  return ctx->current == 0;
+}
+
+
+static inline TYPED_QUEUE_TYPE *TQ(current) (TQ(context) * ctx) {
+
+  assert(ctx->current != 0 && "NULL pointer in function pointer_to_current()");
+  return &ctx->current->info;
+}
+
+
+static inline int TQ(current_priority) (TQ(context) * ctx) {
+
+  assert(ctx->current != 0 && "NULL pointer in function current_priority()");
+  return ctx->current->priority;
+}
+
+
+/* deletes the element at the current local position; the next one
+   becomes current.
+*/
+static inline void TQ(delete_current) (TQ(context) * ctx) {
+
+  TQ(element) * temp = ctx->current;
+  TYPED_QUEUE_NAME *q = ctx->queue;
+
+  assert(temp != 0 && "NULL pointer in function delete_current()");
+  if(ctx->previous == 0) {	// deletion at beginning
+    q->queue = temp->next;
+  }
+  else {			// internal deletion
+    ctx->previous->next = temp->next;
+  }
+  if(q->tail == temp) {
+    q->tail = ctx->previous;
+  }
+  ctx->current = temp->next;
+  free(temp);
+  (q->queuelength)--;
+}
+
+
+#undef TQ
+#undef TYPED_QUEUE_CONCAT
+#undef TYPED_QUEUE_CONCAT_
+#undef TYPED_QUEUE_NAME
+#undef TYPED_QUEUE_TYPE
+#undef TYPED_QUEUE_EQUAL
@@ -0,0 +1,64 @@
+/**
+ *  series.c
+ *  mlqfs
+ *
+ *  Writer for the scheduler occupancy time series.
+ */
+
+#include <string.h>
+#include "prioque.h"
+#include "checkpoint.h"
+#include "series.h"
+
+
+/**
+ * @brief Create a time series file
+ * Paths ending in ".bin" get binary records after a magic and level count
+ * header, anything else gets CSV with a header line.
+ * @returns TRUE on success.
+ */
+int open_series(Series *series, const char *path) {
+    size_t length = strlen(path);
+
+    series->binary = length >= 4 && strcmp(path + length - 4, ".bin") == 0;
+    series->stream = fopen(path, series->binary ? "wb" : "w");
+    if (series->stream == NULL) { return FALSE; }
+
+    if (series->binary) {
+        return write_u32(series->stream, SERIES_MAGIC) && write_u32(series->stream, LEVELS);
+    }
+
+    fprintf(series->stream, "time,ticks");
+    for (int level = 1; level <= LEVELS; level ++) { fprintf(series->stream, ",ready%d", level); }
+    for (int level = 1; level <= LEVELS; level ++) { fprintf(series->stream, ",io%d", level); }
+    fprintf(series->stream, ",running,null_share\n");
+    return TRUE;
+}
+
+
+/**
+ * @brief Append one sample.
+ * @returns TRUE on success.
+ */
+int write_sample(Series *series, Sample *sample) {
+    if (series->binary) {
+        int success = write_u32(series->stream, sample->time)
+            && write_u32(series->stream, sample->ticks);
+        for (int level = 0; level < LEVELS && success; level ++) { success = write_u32(series->stream, sample->ready[level]); }
+        for (int level = 0; level < LEVELS && success; level ++) { success = write_u32(series->stream, sample->io[level]); }
+        return success
+            && write_u32(series->stream, (unsigned int)sample->running)
+            && write_u32(series->stream, sample->null_ticks);
+    }
+
+    fprintf(series->stream, "%u,%u", sample->time, sample->ticks);
+    for (int level = 0; level < LEVELS; level ++) { fprintf(series->stream, ",%u", sample->ready[level]); }
+    for (int level = 0; level < LEVELS; level ++) { fprintf(series->stream, ",%u", sample->io[level]); }
+    return fprintf(series->stream, ",%d,%.3f\n", sample->running, (double)sample->null_ticks / sample->ticks) > 0;
+}
+
+
+void close_series(Series *series) {
+    if (series->stream != NULL) { fclose(series->stream); }
+    series->stream = NULL;
+}
@@ -0,0 +1,47 @@
+/**
+ *  series.h
+ *  mlqfs
+ *
+ *  Writer for the scheduler occupancy time series, as CSV or as compact
+ *  little endian binary records.
+ */
+
+#ifndef series_h
+#define series_h
+
+#include <stdio.h>
+#include "policy.h"
+
+#define SERIES_MAGIC 0x5354514d   // "MQTS"
+
+typedef struct Sample {
+    unsigned int time;              // clock at the end of the sampled interval.
+    unsigned int ticks;             // length of the interval, shorter for the last one.
+    unsigned int ready[LEVELS];     // ready queue length of each level.
+    unsigned int io[LEVELS];        // processes in I/O, by the level they return to.
+    int running;                    // pid which ran the last tick, 0 for the null process.
+    unsigned int null_ticks;        // ticks of the interval run by the null process.
+} Sample;
+
+typedef struct Series {
+    FILE *stream;
+    int binary;
+} Series;
+
+/**
+ * @brief Create a time series file
+ * Paths ending in ".bin" get binary records after a magic and level count
+ * header, anything else gets CSV with a header line.
+ * @returns TRUE on success.
+ */
+int open_series(Series *series, const char *path);
+
+/**
+ * @brief Append one sample.
+ * @returns TRUE on success.
+ */
+int write_sample(Series *series, Sample *sample);
+
+void close_series(Series *series);
+
+#endif /* series_h */
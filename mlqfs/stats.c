@@ -0,0 +1,137 @@
+/**
+ *  stats.c
+ *  mlqfs
+ *
+ *  Streaming summaries of a series of samples.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+
+static int compare_doubles(const void *lhs, const void *rhs) {
+    double left = *(const double *)lhs, right = *(const double *)rhs;
+    return (left > right) - (left < right);
+}
+
+
+void init_quantile(Quantile *quantile, double p) {
+    quantile->p = p;
+    quantile->count = 0;
+}
+
+
+/**
+ * @brief Adjust a middle marker by one position, with a piecewise parabolic
+ * prediction of its height, or a linear one if the parabola isn't monotonic.
+ */
+static void adjust_marker(Quantile *quantile, int i, int d) {
+    double *h = quantile->heights;
+    int *n = quantile->positions;
+    double parabolic = h[i] + (double)d / (n[i + 1] - n[i - 1])
+        * ((n[i] - n[i - 1] + d) * (h[i + 1] - h[i]) / (n[i + 1] - n[i])
+           + (n[i + 1] - n[i] - d) * (h[i] - h[i - 1]) / (n[i] - n[i - 1]));
+
+    if (h[i - 1] < parabolic && parabolic < h[i + 1]) {
+        h[i] = parabolic;
+    } else {
+        h[i] += d * (h[i + d] - h[i]) / (n[i + d] - n[i]);
+    }
+    n[i] += d;
+}
+
+
+/**
+ * @brief Place the five markers on the exact samples, once they overflow.
+ */
+static void init_markers(Quantile *quantile) {
+    int count = QUANTILE_EXACT_SAMPLES;
+    double p = quantile->p;
+    const double fractions[5] = { 0, p / 2, p, (1 + p) / 2, 1 };
+
+    qsort(quantile->samples, count, sizeof(double), compare_doubles);
+    for (int i = 0; i < 5; i ++) {
+        quantile->desired[i] = 1 + (count - 1) * fractions[i];
+        quantile->positions[i] = (int)(quantile->desired[i] + 0.5);
+    }
+
+    // markers must sit on distinct samples.
+    for (int i = 3; i > 0; i --) {
+        if (quantile->positions[i] >= quantile->positions[i + 1]) { quantile->positions[i] = quantile->positions[i + 1] - 1; }
+    }
+    for (int i = 0; i < 5; i ++) { quantile->heights[i] = quantile->samples[quantile->positions[i] - 1]; }
+}
+
+
+void add_quantile_sample(Quantile *quantile, double sample) {
+    double *h = quantile->heights;
+    int *n = quantile->positions;
+    double p = quantile->p;
+    const double increments[5] = { 0, p / 2, p, (1 + p) / 2, 1 };
+    int cell;
+
+    if (quantile->count < QUANTILE_EXACT_SAMPLES) {
+        quantile->samples[quantile->count ++] = sample;
+        return;
+    }
+    if (quantile->count == QUANTILE_EXACT_SAMPLES) { init_markers(quantile); }
+
+    // find the cell of the sample, extending the extreme markers.
+    if (sample < h[0]) {
+        h[0] = sample;
+        cell = 0;
+    } else if (sample >= h[4]) {
+        h[4] = sample;
+        cell = 3;
+    } else {
+        for (cell = 0; sample >= h[cell + 1]; cell ++) {}
+    }
+
+    for (int i = cell + 1; i < 5; i ++) { n[i] ++; }
+    for (int i = 0; i < 5; i ++) { quantile->desired[i] += increments[i]; }
+    quantile->count ++;
+
+    for (int i = 1; i < 4; i ++) {
+        double d = quantile->desired[i] - n[i];
+        if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+            adjust_marker(quantile, i, d > 0 ? 1 : -1);
+        }
+    }
+}
+
+
+double quantile_value(Quantile *quantile) {
+    double sorted[QUANTILE_EXACT_SAMPLES];
+
+    if (quantile->count == 0) { return 0; }
+    if (quantile->count > QUANTILE_EXACT_SAMPLES) { return quantile->heights[2]; }
+
+    // nearest rank over the exact samples.
+    memcpy(sorted, quantile->samples, quantile->count * sizeof(double));
+    qsort(sorted, quantile->count, sizeof(double), compare_doubles);
+    return sorted[(int)(quantile->p * (quantile->count - 1) + 0.5)];
+}
+
+
+void init_summary(Summary *summary) {
+    summary->count = 0;
+    summary->sum = 0;
+    summary->max = 0;
+    init_quantile(&summary->p50, 0.5);
+    init_quantile(&summary->p99, 0.99);
+}
+
+
+void add_sample(Summary *summary, double sample) {
+    if (summary->count == 0 || sample > summary->max) { summary->max = sample; }
+    summary->count ++;
+    summary->sum += sample;
+    add_quantile_sample(&summary->p50, sample);
+    add_quantile_sample(&summary->p99, sample);
+}
+
+
+double summary_mean(Summary *summary) {
+    return summary->count > 0 ? summary->sum / summary->count : 0;
+}
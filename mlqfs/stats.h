@@ -0,0 +1,42 @@
+/**
+ *  stats.h
+ *  mlqfs
+ *
+ *  Streaming summaries of a series of samples: count, mean, max and
+ *  estimated quantiles, in constant memory whatever the number of samples.
+ *  Quantiles are exact over the first QUANTILE_EXACT_SAMPLES samples, then
+ *  estimated with the P-square algorithm (Jain & Chlamtac), which keeps five
+ *  markers per quantile.
+ */
+
+#ifndef stats_h
+#define stats_h
+
+#define QUANTILE_EXACT_SAMPLES 64
+
+typedef struct Quantile {
+    double p;                                   // estimated quantile, in ]0, 1[.
+    double samples[QUANTILE_EXACT_SAMPLES];     // the first samples, kept until the markers take over.
+    double heights[5];                          // marker heights.
+    int positions[5];                           // marker positions.
+    double desired[5];                          // desired marker positions.
+    unsigned long long count;
+} Quantile;
+
+typedef struct Summary {
+    unsigned long long count;
+    double sum;
+    double max;
+    Quantile p50;
+    Quantile p99;
+} Summary;
+
+void init_summary(Summary *summary);
+void add_sample(Summary *summary, double sample);
+double summary_mean(Summary *summary);
+
+void init_quantile(Quantile *quantile, double p);
+void add_quantile_sample(Quantile *quantile, double sample);
+double quantile_value(Quantile *quantile);
+
+#endif /* stats_h */
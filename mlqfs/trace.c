@@ -0,0 +1,133 @@
+/**
+ *  trace.c
+ *  mlqfs
+ *
+ *  Streaming exporter of the schedule in the Chrome Trace Event JSON format.
+ */
+
+#include <stdarg.h>
+#include "prioque.h"
+#include "trace.h"
+
+// Trace "processes" grouping the tracks.
+#define CPU_TRACK 1
+#define PROCESS_TRACKS 2
+
+
+/**
+ * @brief Write one event object, the array separator included.
+ */
+static void write_event(Trace *trace, const char *format, ...) {
+    va_list arguments;
+
+    fprintf(trace->stream, trace->events > 0 ? ",\n" : "\n");
+    va_start(arguments, format);
+    vfprintf(trace->stream, format, arguments);
+    va_end(arguments);
+    trace->events ++;
+}
+
+
+/**
+ * @brief End the CPU slice being traced, on the CPU track and on its process track.
+ */
+static void end_slice(Trace *trace, unsigned int time) {
+    if (trace->slice_pid == 0) { return; }
+    if (time > trace->slice_start) {
+        write_event(trace, "{\"name\": \"Process %d\", \"cat\": \"run\", \"ph\": \"X\", \"ts\": %u, \"dur\": %u, \"pid\": %d, \"tid\": 0, \"args\": {\"level\": %d}}",
+                    trace->slice_pid, trace->slice_start, time - trace->slice_start, CPU_TRACK, trace->slice_level + 1);
+        write_event(trace, "{\"name\": \"run L%d\", \"cat\": \"run\", \"ph\": \"X\", \"ts\": %u, \"dur\": %u, \"pid\": %d, \"tid\": %d}",
+                    trace->slice_level + 1, trace->slice_start, time - trace->slice_start, PROCESS_TRACKS, trace->slice_pid);
+    }
+    trace->slice_pid = 0;
+}
+
+
+/**
+ * @brief Start a trace file, with the track names.
+ * The slice state is kept, so a restored slice carries on.
+ * @returns TRUE on success.
+ */
+int open_trace(Trace *trace, const char *path) {
+    trace->events = 0;
+    trace->stream = fopen(path, "w");
+    if (trace->stream == NULL) { return FALSE; }
+
+    fprintf(trace->stream, "{\"traceEvents\": [");
+    write_event(trace, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"CPU\"}}", CPU_TRACK);
+    write_event(trace, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, \"args\": {\"name\": \"CPU 0\"}}", CPU_TRACK);
+    write_event(trace, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"Processes\"}}", PROCESS_TRACKS);
+    return TRUE;
+}
+
+
+/**
+ * @brief A process entered the scheduler: names its track.
+ */
+void trace_create(Trace *trace, unsigned int time, int pid) {
+    if (trace->stream == NULL) { return; }
+    write_event(trace, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"Process %d\"}}",
+                PROCESS_TRACKS, pid, pid);
+    write_event(trace, "{\"name\": \"create\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %u, \"pid\": %d, \"tid\": %d}",
+                time, PROCESS_TRACKS, pid);
+}
+
+
+/**
+ * @brief A process starts a run on the CPU, ending the current slice.
+ */
+void trace_run(Trace *trace, unsigned int time, int pid, int level) {
+    if (trace->stream == NULL) { return; }
+    end_slice(trace, time);
+    trace->slice_pid = pid;
+    trace->slice_level = level;
+    trace->slice_start = time;
+}
+
+
+/**
+ * @brief The null process runs, ending the current slice.
+ */
+void trace_idle(Trace *trace, unsigned int time) {
+    if (trace->stream == NULL) { return; }
+    end_slice(trace, time);
+}
+
+
+/**
+ * @brief A process is back from an I/O wait started at 'start'.
+ */
+void trace_io(Trace *trace, unsigned int start, unsigned int end, int pid) {
+    if (trace->stream == NULL) { return; }
+    write_event(trace, "{\"name\": \"I/O\", \"cat\": \"io\", \"ph\": \"X\", \"ts\": %u, \"dur\": %u, \"pid\": %d, \"tid\": %d}",
+                start, end - start, PROCESS_TRACKS, pid);
+}
+
+
+/**
+ * @brief A process was promoted or demoted.
+ */
+void trace_level(Trace *trace, unsigned int time, int pid, int from, int to) {
+    if (trace->stream == NULL) { return; }
+    write_event(trace, "{\"name\": \"%s to L%d\", \"cat\": \"level\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %u, \"pid\": %d, \"tid\": %d, \"args\": {\"from\": %d, \"to\": %d}}",
+                to < from ? "promoted" : "demoted", to + 1, time, PROCESS_TRACKS, pid, from + 1, to + 1);
+}
+
+
+void trace_finish(Trace *trace, unsigned int time, int pid) {
+    if (trace->stream == NULL) { return; }
+    write_event(trace, "{\"name\": \"finish\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %u, \"pid\": %d, \"tid\": %d}",
+                time, PROCESS_TRACKS, pid);
+}
+
+
+/**
+ * @brief End the current slice and terminate the JSON document.
+ */
+void close_trace(Trace *trace, unsigned int time) {
+    if (trace->stream == NULL) { return; }
+    end_slice(trace, time);
+    fprintf(trace->stream, "\n]}\n");
+    fclose(trace->stream);
+    trace->stream = NULL;
+}
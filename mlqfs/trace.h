@@ -0,0 +1,64 @@
+/**
+ *  trace.h
+ *  mlqfs
+ *
+ *  Streaming exporter of the schedule in the Chrome Trace Event JSON format,
+ *  readable by chrome://tracing and Perfetto. One tick is shown as one
+ *  microsecond. The CPU has its own track with a slice per run, and every
+ *  process has a track with its runs, I/O waits and level changes.
+ *  Events are written as they happen, nothing is buffered.
+ */
+
+#ifndef trace_h
+#define trace_h
+
+#include <stdio.h>
+
+typedef struct Trace {
+    FILE *stream;           // NULL when tracing is off, every call is then a no-op.
+    int events;             // events written so far.
+    int slice_pid;          // process holding the CPU slice being traced, 0 if idle.
+    int slice_level;
+    unsigned int slice_start;
+} Trace;
+
+/**
+ * @brief Start a trace file, with the track names.
+ * The slice state is kept, so a restored slice carries on.
+ * @returns TRUE on success.
+ */
+int open_trace(Trace *trace, const char *path);
+
+/**
+ * @brief A process entered the scheduler: names its track.
+ */
+void trace_create(Trace *trace, unsigned int time, int pid);
+
+/**
+ * @brief A process starts a run on the CPU, ending the current slice.
+ */
+void trace_run(Trace *trace, unsigned int time, int pid, int level);
+
+/**
+ * @brief The null process runs, ending the current slice.
+ */
+void trace_idle(Trace *trace, unsigned int time);
+
+/**
+ * @brief A process is back from an I/O wait started at 'start'.
+ */
+void trace_io(Trace *trace, unsigned int start, unsigned int end, int pid);
+
+/**
+ * @brief A process was promoted or demoted.
+ */
+void trace_level(Trace *trace, unsigned int time, int pid, int from, int to);
+
+void trace_finish(Trace *trace, unsigned int time, int pid);
+
+/**
+ * @brief End the current slice and terminate the JSON document.
+ */
+void close_trace(Trace *trace, unsigned int time);
+
+#endif /* trace_h */